@@ -5,15 +5,18 @@
 // cataldo.azzariti@gmail.com
 
 
+#include <atomic>
+#include <exception>
 #include <iostream>
+#include <thread>
 #include <Eigen/Dense>
 using namespace std;
 using namespace Eigen;
 
 // sight_level of the opponent algorithm
 int max_level = 2;
-// flag for saving moves
-bool save_move = false;
+// flag for saving moves, of the game played by the thread
+thread_local bool save_move = false;
 
 #include <mcts.h>
 
@@ -21,35 +24,238 @@ bool save_move = false;
 #include "connect_four.h"
 
 
+const int MAX_SIGHT = 5;
+
+
+
+/* What a game adds to the time series and the counters of the experiment.
+   When games are played in parallel, the lines the game appends to the
+   result files are kept in files until the game is merged. */
+struct GameRecord
+{
+  vector<vector<ConnectFourState::Move>> TS_sight_array; 
+  vector<vector<double>> TS_belief_sight;
+  vector<ConnectFourState::Move> moves_chosen;
+  int winner;  // 1 or 2, 0 for a draw
+  MCTS::ResultBuffer files;
+};
+/* END OF STRUCT DEFINITION */
+
+
+
+/* Function to play a game, from the belief prior on the sight of player 1,
+   which it updates. The sight arrays are computed once per position of the
+   game, whether by the driver or inside the adaptative search. */
+void play_game(bool human_player, RowVectorXd& prior, 
+	       const MatrixXd& link_matrix,
+	       MCTS::ComputeOptions player1_options,
+	       MCTS::ComputeOptions player2_options,
+	       GameRecord& record)
+{
+  string filename = "";  // to allow file savings  
+
+  MCTS::SightArrayCache sight_cache;
+  player1_options.sight_cache = &sight_cache;
+  player2_options.sight_cache = &sight_cache;
+
+  ConnectFourState state;
+  int moves_per_player = 0;
+  vector<double> updated_post;
+  while (state.has_moves()) {
+
+    /* toggle on-off to suppress output to console */
+    //cout << endl << "State: " << state << endl;   
+
+    ConnectFourState::Move move = ConnectFourState::no_move;
+    if (state.player_to_move == 1) {
+      
+      /* We assume the opponent move first */
+      vector<ConnectFourState::Move> sight_array = 
+	MCTS::sight_array(state, MAX_SIGHT, player1_options);
+      record.TS_sight_array.push_back(sight_array);
+      move = MCTS::compute_move_capped(state, player1_options);
+
+      /* save move for hit-rate analysis */
+      if (save_move) {
+	filename = "Sight_";
+	filename += (char)(max_level + '0');
+	filename += "/moves_inferred.txt";
+	MCTS::ResultFile out5(filename);
+	out5 << " " << move << endl;
+      }
+
+      state.do_move(move);
+      moves_per_player++;
+      record.moves_chosen.push_back(move);
+
+
+      /* Probabilistic Update */
+      prior = MCTS::update_prior(move, sight_array, prior, MAX_SIGHT, 
+				 link_matrix);
+      // store time series in a matrix
+      updated_post.clear();
+      for (int i = 0; i < MAX_SIGHT; i++){
+	updated_post.push_back(prior(i));
+      }
+      record.TS_belief_sight.push_back(updated_post);
+    }
+    
+    /* Part for human player, if present. Not used for DSEM but left it
+       anyways */
+    else {
+      if (human_player) {
+	while (true) {
+	  cout << "Input your move: ";
+	  move = ConnectFourState::no_move;
+	  cin >> move;
+	  try {
+	    state.do_move(move);
+	    break;
+	  }
+	  catch (std::exception& ) {
+	    cout << "Invalid move." << endl;
+	  }
+	  moves_per_player++;
+	}
+      }
+
+      /* Unconstrained or Adaptative algo part. We assume it moves second. */
+      else {
+        
+	/* TOGGLE ON FOR ADAPTATIVE !!!!!!!!!!!! */
+	move = MCTS::compute_adaptative_move_UCT(state, MAX_SIGHT, 
+						 updated_post,player2_options);
+
+
+	/* Old piece of algo, which used traditional MCTS, replaced by 
+	   adaptative */
+	//move = MCTS::compute_move(state, player2_options);
+	/* old piece of algo replaced by adaptative */
+
+	state.do_move(move);
+	moves_per_player++;
+
+      }
+    }
+    
+    /* Toggle on-off, to check-point algorithms to analyse 
+       intermediate trees.  */
+    //cout << "Press a key to continue: ";
+    //cin >> a_key;
+  }
+
+  /* toggle on-off - to control output to console*/
+  //cout << endl << "Final state: " << state << endl;
+
+
+
+  /* Part to signal game end to data-containing arrays */
+  record.TS_belief_sight.push_back(vector<double>(MAX_SIGHT, -9999));
+  record.TS_sight_array.push_back(vector<ConnectFourState::Move>(MAX_SIGHT,
+								 -9999));
+  record.moves_chosen.push_back(-9999);
+
+  // Lambda evidence
+  filename = "Sight_";
+  filename += (char)(max_level + '0');
+  filename += "/lambda_evidence.txt";
+  {
+    MCTS::ResultFile out1(filename);
+    for (unsigned int i = 0; i < MAX_SIGHT; i++){
+      out1 << -9999 << " " ;
+    }
+    out1 << endl;
+  }
+
+  // Move inferred
+  filename = "Sight_";
+  filename += (char)(max_level + '0');
+  filename += "/moves_inferred.txt";
+  {
+    MCTS::ResultFile out1(filename);
+    out1 << -9999 << endl;
+    //    out1 << " " << endl;
+  }
+
+
+
+  // % win
+  filename = "Sight_";
+  filename += (char)(max_level + '0');
+  filename += "/TS_%_win.txt";
+  {
+    MCTS::ResultFile out7(filename);
+    out7 << -9999;
+    out7 << endl;
+  }
+
+  // % visits
+  filename = "Sight_";
+  filename += (char)(max_level + '0');
+  filename += "/TS_%_visits.txt";
+  {
+    MCTS::ResultFile out7(filename);
+    out7 << -9999;
+    out7 << endl;
+  }
+
+  // Moves per player
+  filename = "Sight_";
+  filename += (char)(max_level + '0');
+  filename += "/moves_per_player.txt";
+  {
+    MCTS::ResultFile out7(filename);
+    if (state.get_result(2) == 1.0) {
+      out7 << "W ";
+    }
+    else
+      out7 << "L ";
+    out7 << moves_per_player;
+    out7 << endl;
+  }
+  /* End of part to signal game end to data-containing arrays */
+  
+
+  /* Assign victory to the players. */
+  if (state.get_result(2) == 1.0) {
+    record.winner = 1;
+    /* toggle on-off - to control output to console */
+    //cout << "Player 1 wins!" << endl;
+  }
+  else if (state.get_result(1) == 1.0) {
+    record.winner = 2;
+    /* toggle on-off - to control output to console */
+    //cout << "Player 2 wins!" << endl;
+  }
+  else {
+    record.winner = 0;
+    /* toggle on-off - to control output to console */
+    //cout << "Nobody wins!" << endl;
+  }
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
 void main_program()
 {
   using namespace std;
 
   bool human_player = false;   // toggle true-false for human player
+  bool parallel_games = false; // toggle true-false to play games in parallel
   int games_won_P1 = 0;
   int games_won_P2 = 0;
   int games_drawn = 0;
-  int moves_per_player = 0;
   int games_to_play = 100;    // choose as desired
-  const int MAX_SIGHT = 5;
   vector<vector<ConnectFourState::Move>> TS_sight_array; 
   vector<ConnectFourState::Move> moves_chosen;
   RowVectorXd lambda_evidence(MAX_SIGHT);
   RowVectorXd prior(MAX_SIGHT);
-  vector<double> updated_post;
 
   /* TOGGLE A-KEY ON-OFF */
   //char a_key; // to make algos wait    // toggle on-off
   MatrixXd link_matrix(MAX_SIGHT, MAX_SIGHT);
   vector<vector<double>> TS_belief_sight;
-  vector<double> game_break;
-  for (int i=0; i<MAX_SIGHT; i++){
-    game_break.push_back(-9999);
-  }
-  vector<ConnectFourState::Move> game_break_SA;
-  for (int i=0; i<MAX_SIGHT; i++){
-    game_break_SA.push_back(-9999);
-  }
   string filename = "";  // to allow file savings  
 
 
@@ -85,184 +291,89 @@ void main_program()
 
   
 
-  // Outer loop for each game
-  for (int i=0; i<games_to_play; i++){
-    
-    ConnectFourState state;
-    moves_per_player = 0;
-    while (state.has_moves()) {
-
-      /* toggle on-off to suppress output to console */
-      //cout << endl << "State: " << state << endl;   
-
-      ConnectFourState::Move move = ConnectFourState::no_move;
-      if (state.player_to_move == 1) {
-	
-	/* We assume the opponent move first */
-	vector<ConnectFourState::Move> sight_array = 
-	  MCTS::sight_array(state, MAX_SIGHT, player1_options);
-	TS_sight_array.push_back(sight_array);
-	move = MCTS::compute_move_capped(state, player1_options);
-
-	/* save move for hit-rate analysis */
-	if (save_move) {
-	  filename = "Sight_";
-	  filename += (char)(max_level + '0');
-	  filename += "/moves_inferred.txt";
-	  out5.open(filename, std::fstream::app);	  
-	  out5 << " " << move << endl;
-	  out5.close();
-	}
-
-	state.do_move(move);
-	moves_per_player++;
-	moves_chosen.push_back(move);
-
-
-	/* Probabilistic Update */
-	prior = MCTS::update_prior(move, sight_array, prior, MAX_SIGHT, 
-				   link_matrix);
-	// store time series in a matrix
-	updated_post.clear();
-	for (int i = 0; i < MAX_SIGHT; i++){
-	  updated_post.push_back(prior(i));
-	}
-	TS_belief_sight.push_back(updated_post);
+  /* Function to add a finished game to the experiment, in the order of 
+     the games */
+  auto merge_game = [&](GameRecord& record)
+    {
+      record.files.append_to_files();
+      TS_sight_array.insert(TS_sight_array.end(), 
+			    record.TS_sight_array.begin(),
+			    record.TS_sight_array.end());
+      TS_belief_sight.insert(TS_belief_sight.end(), 
+			     record.TS_belief_sight.begin(),
+			     record.TS_belief_sight.end());
+      moves_chosen.insert(moves_chosen.end(), record.moves_chosen.begin(),
+			  record.moves_chosen.end());
+      if (record.winner == 1) {
+	games_won_P1++;
+      }
+      else if (record.winner == 2) {
+	games_won_P2++;
       }
-      
-      /* Part for human player, if present. Not used for DSEM but left it
-	 anyways */
       else {
-	if (human_player) {
-	  while (true) {
-	    cout << "Input your move: ";
-	    move = ConnectFourState::no_move;
-	    cin >> move;
-	    try {
-	      state.do_move(move);
-	      break;
-	    }
-	    catch (std::exception& ) {
-	      cout << "Invalid move." << endl;
+	games_drawn++;
+      }
+    };
+
+  /* Function to report the progress */
+  auto runtime_tracker = [](int i)
+    {
+      cerr <<".";
+      if (!(i%5))
+	cerr <<i<<endl;
+    };
+
+
+  if ( ! parallel_games || human_player) {
+    // Outer loop for each game, the belief on the sight of player 1 being
+    // carried from one game to the next.
+    for (int i=0; i<games_to_play; i++){
+      GameRecord record;
+      play_game(human_player, prior, link_matrix, player1_options,
+		player2_options, record);
+      merge_game(record);
+      runtime_tracker(i);
+    }
+  }
+  else {
+    // One thread per core takes the next game to play, until there are 
+    // none left. Each game starts from the prior, with its own belief, 
+    // and keeps what it writes to the result files in its record.
+    vector<GameRecord> records(games_to_play);
+    std::atomic<int> next_game(0);
+    int num_threads = max(1, int(std::thread::hardware_concurrency()));
+    vector<std::exception_ptr> errors(num_threads);
+    vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+      threads.push_back(std::thread([&, t]()
+	{
+	  try {
+	    for (int i = next_game++; i < games_to_play; i = next_game++) {
+	      RowVectorXd game_prior = prior;
+	      MCTS::ResultBuffer::of_this_thread() = &records[i].files;
+	      play_game(human_player, game_prior, link_matrix, 
+			player1_options, player2_options, records[i]);
+	      MCTS::ResultBuffer::of_this_thread() = nullptr;
+	      runtime_tracker(i);
 	    }
-	    moves_per_player++;
 	  }
-	}
-
-	/* Unconstrained or Adaptative algo part. We assume it moves second. */
-	else {
-	  
-	  /* TOGGLE ON FOR ADAPTATIVE !!!!!!!!!!!! */
-	  move = MCTS::compute_adaptative_move_UCT(state, MAX_SIGHT, 
-						   updated_post,player2_options);
-
-
-	  /* Old piece of algo, which used traditional MCTS, replaced by 
-	     adaptative */
-	  //move = MCTS::compute_move(state, player2_options);
-	  /* old piece of algo replaced by adaptative */
-
-	  state.do_move(move);
-	  moves_per_player++;
-
-	}
-      }
-      
-      /* Toggle on-off, to check-point algorithms to analyse 
-	 intermediate trees.  */
-      //cout << "Press a key to continue: ";
-      //cin >> a_key;
+	  catch (...) {
+	    errors[t] = std::current_exception();
+	  }
+	}));
     }
-
-    /* toggle on-off - to control output to console*/
-    //cout << endl << "Final state: " << state << endl;
-
-
-
-    /* Part to signal game end to data-containing arrays */
-    TS_belief_sight.push_back(game_break);
-    TS_sight_array.push_back(game_break_SA);
-    moves_chosen.push_back(-9999);
-
-    // Lambda evidence
-    ofstream out1;
-    filename = "Sight_";
-    filename += (char)(max_level + '0');
-    filename += "/lambda_evidence.txt";
-    out1.open(filename, std::fstream::app);
-    for (unsigned int i = 0; i < MAX_SIGHT; i++){
-      out1 << -9999 << " " ;
+    for (auto& thread: threads) {
+      thread.join();
     }
-    out1 << endl;
-    out1.close();
-
-    // Move inferred
-    filename = "Sight_";
-    filename += (char)(max_level + '0');
-    filename += "/moves_inferred.txt";
-    out1.open(filename, std::fstream::app);
-    out1 << -9999 << endl;
-    //    out1 << " " << endl;
-    out1.close();
-
-
-
-    // % win
-    ofstream out7;
-    filename = "Sight_";
-    filename += (char)(max_level + '0');
-    filename += "/TS_%_win.txt";
-    out7.open(filename, std::fstream::app);
-    out7 << -9999;
-    out7 << endl;
-    out7.close();
-
-    // % visits
-    filename = "Sight_";
-    filename += (char)(max_level + '0');
-    filename += "/TS_%_visits.txt";
-    out7.open(filename, std::fstream::app);
-    out7 << -9999;
-    out7 << endl;
-    out7.close();
-
-    // Moves per player
-    filename = "Sight_";
-    filename += (char)(max_level + '0');
-    filename += "/moves_per_player.txt";
-    out7.open(filename, std::fstream::app);
-    if (state.get_result(2) == 1.0) {
-      out7 << "W ";
+    for (auto& error: errors) {
+      if (error) {
+	std::rethrow_exception(error);
+      }
     }
-    else
-      out7 << "L ";
-    out7 << moves_per_player;
-    out7 << endl;
-    out7.close();
-    /* End of part to signal game end to data-containing arrays */
-    
 
-    /* Assign victory to the players. */
-    if (state.get_result(2) == 1.0) {
-      games_won_P1++;
-      /* toggle on-off - to control output to console */
-      //cout << "Player 1 wins!" << endl;
+    for (auto& record: records) {
+      merge_game(record);
     }
-    else if (state.get_result(1) == 1.0) {
-      games_won_P2++;
-      /* toggle on-off - to control output to console */
-      //cout << "Player 2 wins!" << endl;
-    }
-    else {
-      games_drawn++;
-      /* toggle on-off - to control output to console */
-      //cout << "Nobody wins!" << endl;
-    }
-    
-    /* runtime tracker */
-    cerr <<".";
-    if (!(i%5))
-      cerr <<i<<endl;
   }
 
   /* SAVE THE RELEVANT DATA */
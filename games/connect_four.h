@@ -13,6 +13,12 @@ using namespace std;
 
 
 
+/* The board is kept as bitboards: one 64-bit mask of pieces per player,
+   column by column from the bottom, each column having one spare bit on
+   top so that shifts never carry a line over into the next column. With
+   H = num_rows + 1, the cell (row, col), row 0 being the top row, is the
+   bit col * H + (num_rows - 1 - row). Copies are thus trivial and wins are
+   found with a few shifts and masks. */
 class ConnectFourState
 {
 public:
@@ -27,10 +33,17 @@ public:
    : player_to_move(1),
     num_rows(num_rows_),
     num_cols(num_cols_),
-    last_col(-1),
-    last_row(-1)
+    winner(player_markers[0]),
+    hash(0)
       { 
-	board.resize(num_rows, vector<char>(num_cols, player_markers[0]));
+	attest((num_rows + 1) * num_cols <= 64);
+	pieces[0] = 0;
+	pieces[1] = 0;
+	bottom_row = 0;
+	for (int col = 0; col < num_cols; ++col) {
+	  bottom_row |= std::uint64_t(1) << (col * (num_rows + 1));
+	}
+	full_board = bottom_row * ((std::uint64_t(1) << num_rows) - 1);
       }
 
   /* Function to make a move in the board. Takes an integer, corresponding to
@@ -38,31 +51,24 @@ public:
   void do_move(Move move)
   {
     attest(0 <= move && move < num_cols);
-    attest(board[0][move] == player_markers[0]);
+    attest((occupied() & top_cell(move)) == 0);
     check_invariant();
 
-    int row = num_rows - 1;
-    while (board[row][move] != player_markers[0]) row--;
-    board[row][move] = player_markers[player_to_move];
-    last_col = move;
-    last_row = row;
-
-    player_to_move = 3 - player_to_move;
+    drop_piece(move);
   }
   /* END OF FUNCTION DEFINITION */
 
 
-  /* Do a random move. Used by MCTS for the random playouts. */
+  /* Do a random move. */
   template<typename RandomEngine>
     void do_random_move(RandomEngine* engine)
     {
       dattest(has_moves());
       check_invariant();
-      std::uniform_int_distribution<Move> moves(0, num_cols - 1);
 
       while (true) {
-	auto move = moves(*engine);
-	if (board[0][move] == player_markers[0]) {
+	Move move = random_column(engine);
+	if ((occupied() & top_cell(move)) == 0) {
 	  do_move(move);
 	  return;
 	}
@@ -71,23 +77,45 @@ public:
   /* END OF FUNCTION DEFINITION */
 
 
+
+  /* Plays random moves until the game ends and returns get_result(1). Used
+     by MCTS for the random playouts. The free columns are kept in a mask 
+     as the board fills up, so that a draw is checked with a single test,
+     the moves are made without the checks of do_move, and the winner is
+     only looked for around each new piece, by drop_piece. */
+  template<typename RandomEngine>
+    double play_random_to_end(RandomEngine* engine)
+    {
+      check_invariant();
+
+      const std::uint64_t top_row = bottom_row << (num_rows - 1);
+      std::uint64_t columns = get_moves_mask();
+      while (columns != 0) {
+	Move move = random_column(engine);
+	if ((columns & (std::uint64_t(1) << move)) == 0) {
+	  continue;
+	}
+	std::uint64_t cell = drop_piece(move);
+	if (winner != player_markers[0]) {
+	  break;
+	}
+	if (cell & top_row) {
+	  columns &= ~(std::uint64_t(1) << move);
+	}
+      }
+      return get_result(1);
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
   /* Function to check if there are any valid moves left.
      Returns true if so. */
   bool has_moves() const
   {
     check_invariant();
 
-    char winner = get_winner();
-    if (winner != player_markers[0]) {
-      return false;
-    }
-
-    for (int col = 0; col < num_cols; ++col) {
-      if (board[0][col] == player_markers[0]) {
-	return true;
-      }
-    }
-    return false;
+    return winner == player_markers[0] && occupied() != full_board;
   }
   /* END OF FUNCTION DEFINITION */
 
@@ -100,14 +128,14 @@ public:
       check_invariant();
 
       std::vector<Move> moves;
-      if (get_winner() != player_markers[0]) {
+      if (winner != player_markers[0]) {
 	return moves;
       }
 
       moves.reserve(num_cols);
 
       for (int col = 0; col < num_cols; ++col) {
-	if (board[0][col] == player_markers[0]) {
+	if ((occupied() & top_cell(col)) == 0) {
 	  moves.push_back(col);
 	}
       }
@@ -117,69 +145,27 @@ public:
 
 
 
-  /* Check if game is ended and if there is a winner. 
-     Returns the piece of the winner, or '.' if no winner yet. */ 
-  char get_winner() const
+  /* Function to retreive the valid moves as a bitmask, bit col being set if
+     col is a valid move. Same as get_moves, without building a vector. */
+  std::uint64_t get_moves_mask() const
   {
-    if (last_col < 0) {
-      return player_markers[0];
-    }
-
-    // We only need to check around the last piece played.
-    auto piece = board[last_row][last_col];
-
-    // X X X X
-    int left = 0, right = 0;
-    for (int col = last_col - 1; col >= 0 && board[last_row][col] == piece; 
-	 --col) left++;
-    for (int col = last_col + 1; col < num_cols && board[last_row][col]==piece;
-	 ++col) right++;
-    if (left + 1 + right >= 4) {
-      return piece;
-    }
+    check_invariant();
 
-    // X
-    // X
-    // X
-    // X
-    int up = 0, down = 0;
-    for (int row = last_row - 1; row >= 0 && board[row][last_col] == piece;
-	 --row) up++;
-    for (int row = last_row + 1; row < num_rows && board[row][last_col]==piece;
-	 ++row) down++;
-    if (up + 1 + down >= 4) {
-      return piece;
+    if (winner != player_markers[0]) {
+      return 0;
     }
+    return free_columns();
+  }
+  /* END OF FUNCTION DEFINITION */
 
-    // X
-    //  X
-    //   X
-    //    X
-    up = 0;
-    down = 0;
-    for (int row = last_row - 1, col = last_col - 1; row >= 0 && col >= 0 
-	   && board[row][col] == piece; --row, --col) up++;
-    for (int row = last_row + 1, col = last_col + 1; row < num_rows && 
-	   col < num_cols && board[row][col] == piece; ++row, ++col) down++;
-    if (up + 1 + down >= 4) {
-      return piece;
-    }
 
-    //    X
-    //   X
-    //  X
-    // X
-    up = 0;
-    down = 0;
-    for (int row = last_row + 1, col = last_col - 1; row < num_rows && 
-	   col >= 0 && board[row][col] == piece; ++row, --col) up++;
-    for (int row = last_row - 1, col = last_col + 1; row >= 0 && 
-	   col < num_cols && board[row][col] == piece; --row, ++col) down++;
-    if (up + 1 + down >= 4) {
-      return piece;
-    }
 
-    return player_markers[0];
+  /* Check if game is ended and if there is a winner. 
+     Returns the piece of the winner, or '.' if no winner yet. 
+     The winner is found by do_move, only the last piece can make a line. */ 
+  char get_winner() const
+  {
+    return winner;
   }
   /* END OF FUNCTION DEFINITION */
 
@@ -192,7 +178,6 @@ public:
     dattest( ! has_moves());
     check_invariant();
 
-    auto winner = get_winner();
     if (winner == player_markers[0]) {
       return 0.5;
     }
@@ -208,6 +193,17 @@ public:
 
 
 
+  /* Zobrist hash of the position, updated incrementally by do_move. 
+     The player to move follows from the number of pieces, so the pieces
+     alone identify the position. */
+  std::uint64_t get_hash() const
+  {
+    return hash;
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
   /* Helper function to print the board. */
   void print(ostream& out) const
   {
@@ -220,9 +216,9 @@ public:
     for (int row = 0; row < num_rows; ++row) {
       out << "|";
       for (int col = 0; col < num_cols - 1; ++col) {
-	out << board[row][col] << ' ';
+	out << marker_at(row, col) << ' ';
       }
-      out << board[row][num_cols - 1] << "|" << endl;
+      out << marker_at(row, num_cols - 1) << "|" << endl;
     }
     out << "+";
     for (int col = 0; col < num_cols - 1; ++col) {
@@ -237,6 +233,121 @@ public:
 
 private:
 
+  /* Helpers on the bitboards */
+  std::uint64_t occupied() const
+  {
+    return pieces[0] | pieces[1];
+  }
+
+  std::uint64_t column_cells(int col) const
+  {
+    return ((std::uint64_t(1) << num_rows) - 1) << (col * (num_rows + 1));
+  }
+
+  std::uint64_t top_cell(int col) const
+  {
+    return std::uint64_t(1) << (col * (num_rows + 1) + num_rows - 1);
+  }
+
+  /* Bitmask of the columns which are not full, bit col for column col */
+  std::uint64_t free_columns() const
+  {
+    std::uint64_t mask = 0;
+    for (int col = 0; col < num_cols; ++col) {
+      if ((occupied() & top_cell(col)) == 0) {
+	mask |= std::uint64_t(1) << col;
+      }
+    }
+    return mask;
+  }
+
+  char marker_at(int row, int col) const
+  {
+    std::uint64_t cell = std::uint64_t(1) << (col * (num_rows + 1) + 
+					      num_rows - 1 - row);
+    for (int player = 1; player <= 2; ++player) {
+      if (pieces[player - 1] & cell) {
+	return player_markers[player];
+      }
+    }
+    return player_markers[0];
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Drops a piece of the player to move in the column move, which must not
+     be full, and passes the turn. Returns the cell of the new piece. */
+  std::uint64_t drop_piece(Move move)
+  {
+    // Adding the bottom cell carries up to the first free cell.
+    std::uint64_t column = column_cells(move);
+    std::uint64_t cell = (occupied() + (column & bottom_row)) & column;
+    auto& mine = pieces[player_to_move - 1];
+    mine |= cell;
+    if (is_four_in_a_row(mine)) {
+      winner = player_markers[player_to_move];
+    }
+    hash ^= zobrist_key(player_to_move, MCTS::lowest_bit(cell));
+
+    player_to_move = 3 - player_to_move;
+    return cell;
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to draw a column uniformly, full or not. The column is taken
+     from 32 random bits with a multiply and a shift, which is far cheaper 
+     than a uniform_int_distribution for such small ranges (the bias, below
+     2^-29, does not matter for playouts). */
+  template<typename RandomEngine>
+    Move random_column(RandomEngine* engine) const
+    {
+      static_assert(RandomEngine::min() == 0 && 
+		    RandomEngine::max() >= 0xFFFFFFFFu,
+		    "The random engine must give at least 32 random bits.");
+      std::uint64_t bits = std::uint32_t((*engine)());
+      return Move((bits * std::uint64_t(num_cols)) >> 32);
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to check for four in a row among the pieces of a player, in
+     the four directions at once: vertical (shift 1), horizontal (shift H)
+     and the two diagonals (shifts H - 1 and H + 1). */
+  bool is_four_in_a_row(std::uint64_t mask) const
+  {
+    const int H = num_rows + 1;
+    const int shifts[4] = {1, H, H - 1, H + 1};
+    for (auto shift: shifts) {
+      std::uint64_t pairs = mask & (mask >> shift);
+      if (pairs & (pairs >> (2 * shift))) {
+	return true;
+      }
+    }
+    return false;
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Zobrist key of a piece of player on cell: a fixed pseudo-random number
+     (splitmix64 of the piece index), so no table has to be sized to the
+     board and seeded. */
+  static std::uint64_t zobrist_key(int player, int cell)
+  {
+    std::uint64_t z = 0x9E3779B97F4A7C15ULL * (std::uint64_t(cell) * 2 + 
+					       player);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
   /* Function to check if something weird happens with player's numbers. */
   void check_invariant() const
   {
@@ -246,9 +357,11 @@ private:
 
 
   int num_rows, num_cols;
-  vector<vector<char>> board;
-  int last_col;
-  int last_row;
+  std::uint64_t pieces[2];   // pieces of player 1 and player 2
+  std::uint64_t bottom_row;  // bottom cell of every column
+  std::uint64_t full_board;  // every cell of the board
+  char winner;
+  std::uint64_t hash;
 };
 /* END OF CLASS DEFINITION */
 
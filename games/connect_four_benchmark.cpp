@@ -0,0 +1,229 @@
+// Cataldo Azzariti 2016
+// cataldo.azzariti@gmail.com
+
+// Throughput benchmark of the search on the 6x7 Connect Four board.
+// Prints the iterations (games) per second of the tree building functions,
+// from the empty board and from a middle game position, also with 8 
+// playouts per leaf. Then the time per decision of compute_move at small
+// budgets, and its games per second on 1 to 64 threads, with root 
+// parallelization and with a shared tree. Then the time per decision of a
+// SearchSession against an opponent thinking 100 ms per move, with and 
+// without pondering. Run with --pin to bind the workers of the thread pool
+// to cores.
+
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <Eigen/Dense>
+using namespace std;
+using namespace Eigen;
+
+// Globals expected by mcts.h.
+int max_level = 2;
+bool save_move = false;
+
+#include <mcts.h>
+
+
+#include "connect_four.h"
+
+
+
+/* Function to time a tree building function over a few repetitions and
+   print the iterations per second. */
+template<typename BuildTree>
+void benchmark(const string& name, const ConnectFourState& state,
+	       const MCTS::ComputeOptions& options, BuildTree build_tree)
+{
+  const int repetitions = 5;
+
+  // Warm up.
+  build_tree(state, options);
+
+  auto start = chrono::steady_clock::now();
+  for (int r = 0; r < repetitions; r++) {
+    build_tree(state, options);
+  }
+  auto stop = chrono::steady_clock::now();
+  double seconds = chrono::duration<double>(stop - start).count();
+
+  cout << setw(32) << left << name << " "
+       << setw(10) << right << fixed << setprecision(0)
+       << repetitions * double(options.max_iterations) / seconds
+       << " iterations / second" << endl;
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* Function to time compute_move with root parallelization and with a
+   shared tree, for a growing number of threads, and print the games per 
+   second. Both play max_iterations games per thread. */
+void benchmark_threads(const ConnectFourState& state,
+		       MCTS::ComputeOptions options)
+{
+  for (int threads = 1; threads <= 64; threads *= 2) {
+    options.number_of_threads = threads;
+    cout << setw(3) << right << threads << " threads:";
+    for (int shared = 0; shared <= 1; shared++) {
+      options.use_shared_tree = shared;
+      auto start = chrono::steady_clock::now();
+      MCTS::compute_move(state, options);
+      auto stop = chrono::steady_clock::now();
+      double seconds = chrono::duration<double>(stop - start).count();
+      cout << (shared ? "   shared tree " : "   root parallel ")
+	   << setw(10) << right << fixed << setprecision(0)
+	   << threads * double(options.max_iterations) / seconds
+	   << " games / second";
+    }
+    cout << endl;
+  }
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* Function to time many quick decisions of compute_move and print the 
+   average time per decision, which the start of the threads weighs on. */
+void benchmark_latency(const ConnectFourState& state,
+		       MCTS::ComputeOptions options)
+{
+  const int decisions = 2000;
+  auto start = chrono::steady_clock::now();
+  for (int d = 0; d < decisions; d++) {
+    MCTS::compute_move(state, options);
+  }
+  auto stop = chrono::steady_clock::now();
+  double seconds = chrono::duration<double>(stop - start).count();
+  cout << options.max_iterations << " iterations, " 
+       << options.number_of_threads << " threads: "
+       << fixed << setprecision(1) << 1e6 * seconds / decisions 
+       << " microseconds / decision" << endl;
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* Function to play games of a SearchSession against an opponent taking
+   100 ms per move (a random one), and print the average time per decision 
+   of the session and the share of its games played on the opponent's 
+   time. */
+void benchmark_ponder(MCTS::ComputeOptions options, bool ponder)
+{
+  const int games = 3;
+  MCTS::RandomGenerator random_engine(2016);
+  MCTS::SearchSession<ConnectFourState> session(options);
+  int decisions = 0;
+  double seconds = 0;
+  long long games_reused = 0;
+  for (int g = 0; g < games; g++) {
+    session.reset();
+    ConnectFourState state;
+    while (state.has_moves()) {
+      ConnectFourState::Move move;
+      if (state.player_to_move == 1) {
+	auto start = chrono::steady_clock::now();
+	move = session.compute_move(state);
+	auto stop = chrono::steady_clock::now();
+	seconds += chrono::duration<double>(stop - start).count();
+	games_reused += session.reused_games();
+	decisions++;
+	state.do_move(move);
+	session.play(move);
+	if (ponder) {
+	  session.ponder(state);
+	}
+      }
+      else {
+	this_thread::sleep_for(chrono::milliseconds(100));
+	auto moves = state.get_moves();
+	uniform_int_distribution<size_t> replies(0, moves.size() - 1);
+	move = moves[replies(random_engine)];
+	state.do_move(move);
+	session.play(move);
+      }
+    }
+  }
+  cout << (ponder ? "pondering:    " : "no pondering: ")
+       << fixed << setprecision(1) << 1e3 * seconds / decisions 
+       << " ms / decision, " << setprecision(0)
+       << 100.0 * games_reused / 
+          (double(decisions) * options.number_of_threads * 
+	   options.max_iterations)
+       << "% of the games played beforehand" << endl;
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+void main_program()
+{
+  MCTS::ComputeOptions options;
+  options.max_iterations = 100000;
+  options.verbose = false;
+
+  ConnectFourState empty_board;
+  ConnectFourState middle_game;
+  const ConnectFourState::Move opening[] = {3, 3, 2, 4, 4, 2, 5, 1, 1, 5};
+  for (auto move: opening) {
+    middle_game.do_move(move);
+  }
+
+  typedef ConnectFourState State;
+  auto uct = [](const State& state, const MCTS::ComputeOptions& options)
+    {
+      return MCTS::compute_tree(state, options, 12515);
+    };
+  auto unif = [](const State& state, const MCTS::ComputeOptions& options)
+    {
+      return MCTS::compute_tree_unif(state, options, 12515);
+    };
+
+  benchmark("compute_tree (empty)", empty_board, options, uct);
+  benchmark("compute_tree (middle)", middle_game, options, uct);
+  benchmark("compute_tree_unif (empty)", empty_board, options, unif);
+  benchmark("compute_tree_unif (middle)", middle_game, options, unif);
+
+  options.playouts_per_leaf = 8;
+  benchmark("compute_tree 8/leaf (empty)", empty_board, options, uct);
+  benchmark("compute_tree_unif 8/leaf (empty)", empty_board, options, unif);
+  options.playouts_per_leaf = 1;
+
+  cout << endl << "compute_move latency (empty)" << endl;
+  options.number_of_threads = 4;
+  for (int iterations = 10; iterations <= 1000; iterations *= 10) {
+    options.max_iterations = iterations;
+    benchmark_latency(empty_board, options);
+  }
+
+  options.max_iterations = 20000;
+  cout << endl << "compute_move (empty)" << endl;
+  benchmark_threads(empty_board, options);
+
+  options.number_of_threads = 1;
+  options.max_iterations = 50000;
+  cout << endl << "SearchSession, " << options.max_iterations 
+       << " iterations" << endl;
+  benchmark_ponder(options, false);
+  benchmark_ponder(options, true);
+}
+
+
+
+/* Main program. */
+int main(int argc, char* argv[])
+{
+  try {
+    if (argc > 1 && string(argv[1]) == "--pin") {
+      MCTS::configure_thread_pool(max(1u, thread::hardware_concurrency()),
+				  true);
+    }
+    main_program();
+  }
+  catch (std::runtime_error& error) {
+    std::cerr << "ERROR: " << error.what() << std::endl;
+    return 1;
+  }
+}
+/* END OF MAIN PROGRAM */
@@ -14,11 +14,18 @@
 // Originally based on Python code at
 // http://mcts.ai/code/python.html
 //
-// Uses the "root parallelization" technique [1].
+// Uses the "root parallelization" technique [1] or, with 
+// ComputeOptions::use_shared_tree, "tree parallelization" with virtual
+// loss [1]. With ComputeOptions::root_sync_interval, the root 
+// parallelization is "slow" [2]: the trees share the statistics of their
+// root children as they grow.
 //
 // [1] Chaslot, G. M. B., Winands, M. H., & van Den Herik, H. J. (2008).
 //     Parallel monte-carlo tree search. In Computers and Games (pp. 
 //     60-71). Springer Berlin Heidelberg.
+// [2] Soejima, Y., Kishimoto, A., & Watanabe, O. (2010). Evaluating root 
+//     parallelization in Go. IEEE Transactions on Computational 
+//     Intelligence and AI in Games, 2(4), 278-287.
 //
 
 
@@ -38,6 +45,21 @@
   bool has_moves() const;
   std::vector<Move> get_moves() const;
 
+  // Optional. Bitmask of the legal moves, bit m being set if move m can be
+  // played. Used instead of get_moves() when a node is created.
+  std::uint64_t get_moves_mask() const;
+
+  // Optional. Plays random moves until the game ends, leaving the state 
+  // there, and returns get_result(1). Used for the random playouts instead
+  // of do_random_move.
+  template<typename RandomEngine>
+  double play_random_to_end(RandomEngine* engine);
+
+  // Optional. Hash of the position, needed by the transposition mode
+  // (ComputeOptions::use_transpositions). Positions must never repeat
+  // within a game for that mode to be used.
+  std::uint64_t get_hash() const;
+
   // Returns a value in {0, 0.5, 1}.
   // This should not be an evaluation function, because it will only be
   // called for finished games. Return 0.5 to indicate a draw.
@@ -45,6 +67,9 @@
 
   int player_to_move;
 
+  // Moves must be integers in [0, 64): the untried moves of a node are
+  // kept in a 64-bit mask.
+
   // ...
   private:
   // ...
@@ -61,8 +86,11 @@
 
 
 
+#include <atomic>
+
 namespace MCTS
 {
+  class SightArrayCache;
 
   /* Struct defining parameters to make the MCTS algo run */
   struct ComputeOptions
@@ -70,12 +98,41 @@ namespace MCTS
     int number_of_threads;
     int max_iterations;
     double max_time;
+    long long max_memory;
+    bool use_transpositions;
+    bool use_shared_tree;
+    int root_sync_interval;
+    int early_stop_interval;
+    double early_stop_z;
+    std::atomic<long long>* early_stop_saved;
+    int playouts_per_leaf;
+    int leaf_threads;
+    long long random_seed;
+    SightArrayCache* sight_cache;
     bool verbose;
 
   ComputeOptions() :
     number_of_threads(1),  // Leave 1 to start with!!
       max_iterations(100000),
       max_time(-1.0), // default is no time limit.
+      max_memory(-1), // bytes of nodes per tree, default is no limit.
+      use_transpositions(false),
+      use_shared_tree(false), // one tree grown by all the threads together
+      root_sync_interval(-1), // games between the exchanges of root 
+			      // statistics of the threads, default is none
+      early_stop_interval(-1),// games between the checks of the early 
+			      // termination, default is no early termination
+      early_stop_z(3.0),      // lead of the best move, in standard 
+			      // deviations, enough to stop
+      early_stop_saved(nullptr), // games the early termination saved in
+			      // the trees of the call are added to it, 
+			      // default is not counting them
+      playouts_per_leaf(1),   // random games played from each leaf reached
+      leaf_threads(1),        // threads sharing them, with the thread pool
+      random_seed(-1),        // >= 0 for reproducible searches, default is
+			      // seeding from std::random_device
+      sight_cache(nullptr),   // sight arrays computed once per position,
+			      // see SightArrayCache, default is none
       verbose(false)
     { }
   };
@@ -124,25 +181,50 @@ namespace MCTS
 
 
 #include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdlib>
 #include <future>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <random>
 #include <set>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <fstream>
+#include <functional>
+#include <deque>
 #include <Eigen/Dense>
 
 #ifdef USE_OPENMP
 #include <omp.h>
 #endif
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#if defined(USE_SIMD_UCT) && defined(__SSE2__)
+#include <emmintrin.h>
+#define MCTS_SIMD_UCT
+#endif
+
 
 
 namespace MCTS
@@ -165,789 +247,3050 @@ namespace MCTS
 
 
   
-  /* This Node class is used to build the game tree, it is its building block.
-     The root is created by the users and
-     the rest of the tree is created by add_node. */
+  /* Helpers on 64-bit masks of moves */
+  inline int count_bits(std::uint64_t mask)
+  {
+  #ifdef __GNUC__
+    return __builtin_popcountll(mask);
+  #else
+    int count = 0;
+    for (; mask != 0; mask &= mask - 1) count++;
+    return count;
+  #endif
+  }
 
-  template<typename State>
-    class Node
+  inline int lowest_bit(std::uint64_t mask)
+  {
+  #ifdef __GNUC__
+    return __builtin_ctzll(mask);
+  #else
+    int bit = 0;
+    for (; (mask & 1) == 0; mask >>= 1) bit++;
+    return bit;
+  #endif
+  }
+
+  template<typename RandomEngine>
+    int random_bit(std::uint64_t mask, RandomEngine* engine)
     {
-    public:
-      typedef typename State::Move Move;
+      std::uniform_int_distribution<int> bits_distribution(0, 
+							  count_bits(mask) - 1);
 
-      Node(const State& state);
-      ~Node();
+      // Drop the lowest set bits until the chosen one is the lowest.
+      for (int skip = bits_distribution(*engine); skip > 0; --skip) {
+	mask &= mask - 1;
+      }
+      return lowest_bit(mask);
+    }
 
-      bool has_untried_moves() const;
-      template<typename RandomEngine>
-	Move get_untried_move(RandomEngine* engine) const;
-      Node* best_child() const;
 
-      bool has_children() const
-      {
-	return ! children.empty();
-      }
 
-      Node* select_child_UCT() const;
-      template<typename RandomEngine>
-	Node* select_child_unif(RandomEngine* engine) const;
-      Node* add_child(const Move& move, const State& state);
-      void update(double result);
+  /* Random generator of the searches: xoshiro256** (Blackman & Vigna), 
+     seeded through splitmix64. Its 32 bytes of state are set up in a few
+     operations, against 2.5 kB for std::mt19937_64, and each number costs
+     a handful of shifts and rotations. Compile with USE_MT19937 to search
+     with std::mt19937_64 instead. */
+  class Xoshiro256
+  {
+  public:
+    typedef std::uint64_t result_type;
 
-      std::string to_string() const;
-      std::string tree_to_string(int max_depth = 1000000, int indent = 0) const;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~result_type(0); }
 
-      const Move move;
-      Node* const parent;
-      const int player_to_move;
-	
-      //std::atomic<double> wins;
-      //std::atomic<int> visits;
-      double wins;
-      int visits;
-      double score_from_below; 
-      int BI_depth;  // added to break ties in Back Induction
-      Move move_inferred;
-      
-      std::vector<Move> moves;
-      std::vector<Node*> children;
+    explicit Xoshiro256(std::uint64_t seed = 0)
+    {
+      for (auto& word: state) {
+	word = splitmix64(seed);
+      }
+    }
 
-    private:
-      Node(const State& state, const Move& move, Node* parent);
+    result_type operator()()
+    {
+      const std::uint64_t result = rotate(state[1] * 5, 7) * 9;
+      const std::uint64_t t = state[1] << 17;
+      state[2] ^= state[0];
+      state[3] ^= state[1];
+      state[1] ^= state[2];
+      state[0] ^= state[3];
+      state[2] ^= t;
+      state[3] = rotate(state[3], 45);
+      return result;
+    }
 
-      std::string indent_string(int indent) const;
+    /* Function to advance splitmix64 from x and return its next output,
+       used to spread a seed over the state */
+    static std::uint64_t splitmix64(std::uint64_t& x)
+    {
+      std::uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      return z ^ (z >> 31);
+    }
 
-      Node(const Node&);
-      Node& operator = (const Node&);
+  private:
+    static std::uint64_t rotate(std::uint64_t x, int k)
+    {
+      return (x << k) | (x >> (64 - k));
+    }
 
-      double UCT_score;
-    };
+    std::uint64_t state[4];
+  };
 
+  #ifdef USE_MT19937
+  typedef std::mt19937_64 RandomGenerator;
+  #else
+  typedef Xoshiro256 RandomGenerator;
+  #endif
 
-  /////////////////////////////////////////////////////////
-  /////////////////////////////////////////////////////////
 
-  /**************************************************************/
-  /* BEGIN OF PART FOR FUNCTION DECLARATIONS FOR THE NODE CLASS */
-  /**************************************************************/
 
-								
-  /* Constructor */
-  template<typename State>
-    Node<State>::Node(const State& state) : 
-    move(State::no_move),
-    parent(nullptr),
-    player_to_move(state.player_to_move),
-    wins(0),
-    visits(0),
-    score_from_below(-1),  // CA added
-    move_inferred(-1),
-    moves(state.get_moves()),
-    UCT_score(0)
-      { }
-  /* END OF FUNCTION DEFINITION */
+  /* Function to draw a seed from std::random_device. The device is only 
+     read once per thread, to seed a generator the seeds are then drawn 
+     from. */
+  inline std::uint64_t entropy_seed()
+  {
+    static thread_local Xoshiro256 seeds([]()
+      {
+	std::random_device rd;
+	return (std::uint64_t(rd()) << 32) ^ rd();
+      }());
+    return seeds();
+  }
 
 
 
-  /* Overloaded Private Constructor */
-  template<typename State>
-    Node<State>::Node(const State& state, const Move& move_, Node* parent_) :
-    move(move_),
-    parent(parent_),
-    player_to_move(state.player_to_move),
-    wins(0),
-    visits(0),
-    score_from_below(-1),   // CA added
-    BI_depth(-1),           // CA added
-    move_inferred(-1),
-    moves(state.get_moves()),
-    UCT_score(0)
-      { }
-  /* END OF FUNCTION DEFINITION */
+  /* Function to make the random generator of a search job. With 
+     options.random_seed set, the generator is a function of it and of the
+     initial_seed of the job only, so that the search can be replayed (as
+     long as it is bound by max_iterations, and no tree is shared between
+     threads); the jobs of a search each take a different initial_seed, and
+     get independent streams. Otherwise the seed comes from entropy_seed. */
+  inline RandomGenerator make_random_generator(const ComputeOptions& options,
+					       std::uint64_t initial_seed)
+  {
+    if (options.random_seed < 0) {
+      return RandomGenerator(entropy_seed());
+    }
+    std::uint64_t x = std::uint64_t(options.random_seed);
+    std::uint64_t seed = Xoshiro256::splitmix64(x) ^ initial_seed;
+    return RandomGenerator(Xoshiro256::splitmix64(seed));
+  }
 
 
 
-  /* Destructor - recursively delete all children */
+  /* Detects whether State provides get_moves_mask() */
   template<typename State>
-    Node<State>::~Node()
+    class has_moves_mask
     {
-      for (auto child: children) {
-	delete child;
-      }
-    }
-  /* END OF FUNCTION DEFINITION */
+      template<typename T>
+	static auto test(int) -> decltype(std::declval<const T&>().
+					  get_moves_mask(), std::true_type());
+      template<typename T>
+	static std::false_type test(...);
+
+    public:
+      static const bool value = decltype(test<State>(0))::value;
+    };
 
 
 
-  /* Function to check if a state has some moves available */
-  template<typename State>
-    bool Node<State>::has_untried_moves() const
+  /* Detects whether State provides play_random_to_end() */
+  template<typename State, typename RandomEngine>
+    class has_random_playout
     {
-      return ! moves.empty();
-    }
-  /* END OF FUNCTION DEFINITION */
+      template<typename T>
+	static auto test(int) -> decltype(std::declval<T&>().
+					  play_random_to_end(
+					    std::declval<RandomEngine*>()),
+					  std::true_type());
+      template<typename T>
+	static std::false_type test(...);
+
+    public:
+      static const bool value = decltype(test<State>(0))::value;
+    };
 
 
 
-  /* Get a random move to execute from a state */  
-  template<typename State>
-    template<typename RandomEngine>
-    typename State::Move Node<State>::get_untried_move(RandomEngine* 
-						       engine) const
+  /* Function to play randomly from state until the game ends, for the 
+     SIMULATION phase. Returns the result for player 1 (get_result(1)). */
+  template<typename State, typename RandomEngine>
+    typename std::enable_if<has_random_playout<State, RandomEngine>::value,
+			    double>::type
+    random_playout(State& state, RandomEngine* engine)
+    {
+      return state.play_random_to_end(engine);
+    }
+
+  template<typename State, typename RandomEngine>
+    typename std::enable_if< ! has_random_playout<State, RandomEngine>::value,
+			    double>::type
+    random_playout(State& state, RandomEngine* engine)
     {
-      attest( ! moves.empty());
-      std::uniform_int_distribution<std::size_t> moves_distribution(0,
-							   moves.size() - 1);
-      return moves[moves_distribution(*engine)];
+      while (state.has_moves()) {
+	state.do_random_move(engine);
+      }
+      return state.get_result(1);
     }
   /* END OF FUNCTION DEFINITION */
 
 
 
-  /* Function to select the best child - based on number of visits */
-  template<typename State>
-    Node<State>* Node<State>::best_child() const
-    {
-      attest(moves.empty());
-      attest( ! children.empty() );
+  /* Function to turn the result of a playout for player 1 into the one seen
+     from a node with player_to_move to move, as get_result(player_to_move)
+     would give it. Two players, results in {0, 0.5, 1}. */
+  inline double result_for(int player_to_move, double result_player_1)
+  {
+    return player_to_move == 1 ? result_player_1 : 1.0 - result_player_1;
+  }
+
+  /* Same for the sum of the results of several playouts */
+  inline double result_for(int player_to_move, double results_player_1,
+			   int playouts)
+  {
+    return player_to_move == 1 ? results_player_1 : 
+      playouts - results_player_1;
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
 
-      return *std::max_element(children.begin(), children.end(),
-			       [](Node* a, Node* b) { 
-				 return a->visits < b->visits; 
-			       });;
+  /* Function to get the number of playouts of the iteration starting with 
+     game iter, counted from 1: options.playouts_per_leaf, without going
+     past options.max_iterations games. */
+  inline int playouts_in_batch(const ComputeOptions& options, int iter)
+  {
+    attest(options.playouts_per_leaf >= 1);
+    if (options.max_iterations < 0) {
+      return options.playouts_per_leaf;
     }
+    return std::min(options.playouts_per_leaf, 
+		    options.max_iterations - iter + 1);
+  }
   /* END OF FUNCTION DEFINITION */
 
 
 
+  /* Share of ComputeOptions::max_time held back by compute_move and friends
+     for waiting on their jobs and merging the trees. */
+  const double MERGE_TIME_RESERVE = 0.1;
 
-  /* Function to implement UCT tree-selection policy. */
-  template<typename State>
-    Node<State>* Node<State>::select_child_UCT() const
+  /* Time limit of a search, on std::chrono::steady_clock (no OpenMP
+     needed). A negative number of seconds means no limit. passed() is
+     called once per iteration, but reads the clock only every stride
+     games, the stride being adapted to the measured rate of games so that
+     the clock is read about every check_period. It reports the limit as
+     passed one period ahead, so that the last iteration still ends in
+     time. */
+  class Deadline
+  {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit Deadline(double seconds) :
+      start(Clock::now()),
+      end(start),
+      last_check(start),
+      check_period(std::chrono::duration<double>(std::min(0.001,
+							  seconds / 64))),
+      unlimited(seconds < 0),
+      stride(1),
+      games_since_check(0)
     {
-      attest( ! children.empty() );
-      for (auto child: children) {
-	child->UCT_score = double(child->wins) / double(child->visits) +
-	  std::sqrt(2.0 * std::log(double(this->visits)) / child->visits);
+      if ( ! unlimited) {
+	end += std::chrono::duration_cast<Clock::duration>(
+	  std::chrono::duration<double>(seconds));
+      }
+    }
+
+    /* Counts the games of an iteration, tells whether to stop. */
+    bool passed(int games)
+    {
+      if (unlimited) {
+	return false;
+      }
+      games_since_check += games;
+      if (games_since_check < stride) {
+	return false;
       }
 
-      return *std::max_element(children.begin(), children.end(),
-			       [](Node* a, Node* b) { 
-				 return a->UCT_score < b->UCT_score; });
+      auto now = Clock::now();
+      double since_check = std::chrono::duration<double>(now - last_check).
+	count();
+      // At most doubled, should the first games be quicker than the next.
+      long long next = 2 * (long long)stride;
+      if (since_check > 0) {
+	next = std::min(next, (long long)(games_since_check *
+					  check_period.count() / since_check));
+      }
+      stride = int(std::max(1LL, std::min(next, 1LL << 20)));
+      last_check = now;
+      games_since_check = 0;
+      return now + std::chrono::duration_cast<Clock::duration>(check_period)
+	>= end;
     }
-  /* END OF FUNCTION DEFINITION */
 
+    /* Seconds left before the limit, at least 0, or -1 without limit. To
+       be given as max_time to the jobs of the search, which may start
+       late in the pool. */
+    double remaining() const
+    {
+      if (unlimited) {
+	return -1;
+      }
+      return std::max(0.0, std::chrono::duration<double>(end - Clock::now()).
+		      count());
+    }
 
+    /* Options for a job of the search, ending with it. */
+    ComputeOptions job_options(ComputeOptions options) const
+    {
+      options.max_time = remaining();
+      return options;
+    }
 
+    bool expired() const
+    {
+      return ! unlimited && Clock::now() >= end;
+    }
 
-  /* NEW FUNCTION - To select a child uniformly as opposed with UCT when 
-     descending the tree */
-  template<typename State>
-    template<typename RandomEngine>
-    Node<State>* Node<State>::select_child_unif(RandomEngine* engine) const
+    double elapsed() const
     {
-      std::uniform_int_distribution<std::size_t> moves_distribution(0, 
-						       children.size() - 1);
-      return children[moves_distribution(*engine)];
+      return std::chrono::duration<double>(Clock::now() - start).count();
     }
-  /* END OF FUNCTION DEFINITION */
+
+  private:
+    Clock::time_point start;
+    Clock::time_point end;
+    Clock::time_point last_check;
+    std::chrono::duration<double> check_period;
+    bool unlimited;
+    int stride;
+    int games_since_check;
+  };
 
 
 
-  /* Function to add a child to a Node */
+  /* Detects whether State provides get_hash() */
   template<typename State>
-    Node<State>* Node<State>::add_child(const Move& move, const State& state)
+    class has_hash
     {
-      auto node = new Node(state, move, this);
-      children.push_back(node);
-      attest( ! children.empty());
+      template<typename T>
+	static auto test(int) -> decltype(std::declval<const T&>().
+					  get_hash(), std::true_type());
+      template<typename T>
+	static std::false_type test(...);
 
-      auto itr = moves.begin();
-      for (; itr != moves.end() && *itr != move; ++itr);
-      attest(itr != moves.end());
-      moves.erase(itr);
-      return node;
-    }
-  /* END OF FUNCTION DEFINITION */
+    public:
+      static const bool value = decltype(test<State>(0))::value;
+    };
 
 
 
-  /* Function to backpropagate the result of a random playout */
+  /* Function to get the hash of a state, for the states which have one. */
   template<typename State>
-    void Node<State>::update(double result)
+    typename std::enable_if<has_hash<State>::value, std::uint64_t>::type
+    position_hash(const State& state)
     {
-      visits++;
-      wins += result;
+      return state.get_hash();
     }
-  /* END OF FUNCTION DEFINITION */
-
 
-
-  /* Helper function to convert a Node to a printable format, used to print
-     the tree */
   template<typename State>
-    std::string Node<State>::to_string() const
+    typename std::enable_if< ! has_hash<State>::value, std::uint64_t>::type
+    position_hash(const State& state)
     {
-      std::stringstream sout;
-      sout << "["
-	   << "P" << 3 - player_to_move << " "
-	   << "M:" << move << " "
-	   << "W/V: " << wins << "/" << visits << " "
-	   << "%_win: " << setprecision(2) << fixed << wins/visits << ", " 
-	   << "SFB: " << setprecision(2) << fixed << score_from_below << ", "
-	   << "MI: " << move_inferred << ", "
-	   << "U: " << moves.size() << "]\n";
-      return sout.str();
+      throw std::invalid_argument("State has no get_hash().");
     }
   /* END OF FUNCTION DEFINITION */
 
 
 
-  /* Function to turn a tree to a string to print it */
+  /* Function to get the legal moves of a state as a bitmask, straight from
+     the state when it can provide it, from get_moves() otherwise. */
   template<typename State>
-    std::string Node<State>::tree_to_string(int max_depth, int indent) const
+    typename std::enable_if<has_moves_mask<State>::value, std::uint64_t>::type
+    legal_moves_mask(const State& state)
     {
-      if (indent >= max_depth) {
-	return "";
-      }
+      return state.get_moves_mask();
+    }
 
-      std::string s = indent_string(indent) + to_string();
-      for (auto child: children) {
-	s += child->tree_to_string(max_depth, indent + 1);
+  template<typename State>
+    typename std::enable_if< ! has_moves_mask<State>::value, 
+			    std::uint64_t>::type
+    legal_moves_mask(const State& state)
+    {
+      std::uint64_t mask = 0;
+      for (auto move: state.get_moves()) {
+	attest(0 <= move && move < 64);
+	mask |= std::uint64_t(1) << move;
       }
-      return s;
+      return mask;
     }
   /* END OF FUNCTION DEFINITION */
 
 
 
-  /* Helper function to create indents when printing the tree */
+  /* Function to tell whether two states stand for the same position: by 
+     their hash for the states which have one, by the player to move and 
+     the legal moves otherwise. */
   template<typename State>
-    std::string Node<State>::indent_string(int indent) const
+    typename std::enable_if<has_hash<State>::value, bool>::type
+    same_position(const State& a, const State& b)
     {
-      std::string s = "";
-      for (int i = 1; i <= indent; ++i) {
-	s += "| ";
-      }
-      return s;
+      return a.player_to_move == b.player_to_move && 
+	a.get_hash() == b.get_hash();
     }
-  /* END OF FUNCTION DEFINITION */
-
 
-  /**************************************************************/
-  /* END OF PART FOR FUNCTION DECLARATIONS FOR THE NODE CLASS */
-  /**************************************************************/
+  template<typename State>
+    typename std::enable_if< ! has_hash<State>::value, bool>::type
+    same_position(const State& a, const State& b)
+    {
+      return a.player_to_move == b.player_to_move && 
+	legal_moves_mask(a) == legal_moves_mask(b);
+    }
+  /* END OF FUNCTION DEFINITION */
 
-  /////////////////////////////////////////////////////////
-  /////////////////////////////////////////////////////////
 
 
-  /* Function to compute the tree with the MCTS algorithm. 
-     Used by compute_move.
-     Unconstrained version. */
-  template<typename State>
-    std::unique_ptr<Node<State>>  compute_tree(const State root_state,
-					       const ComputeOptions options,
-					       std::mt19937_64::result_type 
-					       initial_seed)
+  /* Pool of worker threads running the jobs of the searches (the trees of
+     compute_move and friends), so that no thread is started per decision.
+     Jobs are submitted in batches, from new_batch(). A thread waiting for
+     a batch with wait_all() runs the queued jobs of that batch meanwhile,
+     which lets jobs submit and wait for jobs of their own, and no other 
+     job: a whole tree run while waiting for the playouts of a leaf would
+     hold that leaf for as long, and might itself be waiting for the job
+     it was run under.
+     With pin_workers (Linux only), each worker is bound to one core, the
+     workers filling a socket before moving on to the next one; a tree 
+     grown by a pinned worker then takes its memory from the NUMA node of
+     its socket (see NodeArena). */
+  class ThreadPool
+  {
+  public:
+    typedef std::uint64_t Batch;
+
+    explicit ThreadPool(int threads, bool pin_workers = false);
+    ~ThreadPool();
+
+    Batch new_batch();
+    template<typename Function>
+      std::future<typename std::result_of<Function()>::type> 
+      submit(Function function, Batch batch);
+    template<typename Result>
+      void wait_all(const std::vector<std::future<Result>>& futures,
+		    Batch batch);
+    int size() const
     {
+      return int(workers.size());
+    }
 
-      std::random_device rd;
-      std::mt19937_64 random_engine(rd());
-      // Alternative Fixed Seed if provided as a parameter
-      //std::mt19937_64 random_engine(initial_seed);
-
-      attest(options.max_iterations >= 0 || options.max_time >= 0);
-      if (options.max_time >= 0) {
-      #ifndef USE_OPENMP
-	throw std::runtime_error("ComputeOptions::max_time requires OpenMP.");
-      #endif
-      }
+    // Whether the calling thread is a worker bound to a core.
+    static bool& is_pinned_worker()
+    {
+      static thread_local bool pinned = false;
+      return pinned;
+    }
 
-      // Will support more players later.
-      attest(root_state.player_to_move == 1 || root_state.player_to_move == 2);
-      auto root = std::unique_ptr<Node<State>>(new Node<State>(root_state));
+  private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator = (const ThreadPool&);
+
+    template<typename Future>
+      void wait(const Future& future, Batch batch);
+    bool run_pending_job(Batch batch);
+    void work(int cpu);
+
+    std::vector<std::thread> workers;
+    std::deque<std::pair<Batch, std::function<void()>>> jobs;
+    std::mutex mutex;
+    std::condition_variable job_added;
+    bool stopping;
+    std::atomic<Batch> batches;
+  };
 
-      #ifdef USE_OPENMP
-        double start_time = ::omp_get_wtime();
-        double print_time = start_time;
-      #endif
 
-      /* MCTS cycle - selection, expansion, simulation, backpropagation */
-      for (int iter = 1; iter <= options.max_iterations || 
-	     options.max_iterations < 0; ++iter) {
-	
-	auto node = root.get();
-	State state = root_state;
 
-	// SELECTION - Select a path through the tree to a leaf node.
-	while (!node->has_untried_moves() && node->has_children()) {
-	  node = node->select_child_UCT();
-	  state.do_move(node->move);
-	}
-
-	// EXPANSION - If we are not already at the final state, expand the
-	// tree with a new node and move there.
-	if (node->has_untried_moves()) {
-	  auto move = node->get_untried_move(&random_engine);
-	  state.do_move(move);
-	  node = node->add_child(move, state);
-	}
-
-	// SIMULATION - We now play randomly until the game ends.
-	while (state.has_moves()) {
-	  state.do_random_move(&random_engine);
-	}
+  /* Function to list the cores the process may run on, socket by socket,
+     in the order the workers of a pinned pool are bound to them. Empty 
+     where threads cannot be pinned. */
+  inline std::vector<int> cores_by_socket()
+  {
+    std::vector<int> cores;
+  #ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+      return cores;
+    }
+    std::vector<std::pair<int, int>> socket_and_core;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if ( ! CPU_ISSET(cpu, &allowed)) {
+	continue;
+      }
+      std::ifstream package("/sys/devices/system/cpu/cpu" + 
+			    std::to_string(cpu) + 
+			    "/topology/physical_package_id");
+      int socket = 0;
+      package >> socket;
+      socket_and_core.push_back(std::make_pair(socket, cpu));
+    }
+    std::sort(socket_and_core.begin(), socket_and_core.end());
+    for (auto entry: socket_and_core) {
+      cores.push_back(entry.second);
+    }
+  #endif
+    return cores;
+  }
+  /* END OF FUNCTION DEFINITION */
 
-	// BACKPROPAGATION - We have now reached a final state. 
-	// Backpropagate the result up the tree to the root node.
-	while (node != nullptr) {
-	  node->update(state.get_result(node->player_to_move));
-	  node = node->parent;
 
-	}
 
+  inline ThreadPool::ThreadPool(int threads, bool pin_workers) :
+    stopping(false),
+    batches(0)
+  {
+    attest(threads >= 1);
+    std::vector<int> cores;
+    if (pin_workers) {
+      cores = cores_by_socket();
+      check( ! cores.empty(), "Pinning the workers is not supported here.");
+    }
+    for (int t = 0; t < threads; ++t) {
+      int cpu = cores.empty() ? -1 : cores[t % cores.size()];
+      workers.push_back(std::thread(&ThreadPool::work, this, cpu));
+    }
+  }
+  /* END OF FUNCTION DEFINITION */
 
-        #ifdef USE_OPENMP
-	if (options.verbose || options.max_time >= 0) {
-	  double time = ::omp_get_wtime();
-	  if (options.verbose && (time - print_time >= 1.0 || 
-				  iter == options.max_iterations)) {
-	    std::cerr << iter << " games played (";
-	    std::cerr << double(iter) / (time - start_time) << " / second).";
-	    std::cerr << endl;
-	    print_time = time;
-          }
-	     
-	  if (time - start_time >= options.max_time) {
-	    break;
-	  }
-        }
-        #endif
 
-      } //closes for 100k iter MCTS cycle
-	
-      
-      /* Part to print tree */
-      /*std::ofstream out;
-      out.open("TreeFull.txt");
-      out << root->tree_to_string(3,0);
-      out.close();*/
-      /* Part to print tree */
 
-      return root;
+  /* The jobs still queued are run before the workers are stopped */
+  inline ThreadPool::~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    job_added.notify_all();
+    for (auto& worker: workers) {
+      worker.join();
     }
+  }
   /* END OF FUNCTION DEFINITION */
 
 
 
-  /* Function to compute the tree with the MCTS algorithm. 
-     Used by compute_move_capped.
-     Capped version - cap set by max_level. */
-  template<typename State>
-    std::unique_ptr<Node<State>> compute_tree_capped(const State root_state,
-						     const ComputeOptions 
-						     options,
-						     std::mt19937_64::result_type
-						     initial_seed)
-    {
-      // to keep track how deep we are in the tree
-      int level_counter = 0;
+  /* Function to get a new batch of jobs, to be submitted and waited for
+     together */
+  inline ThreadPool::Batch ThreadPool::new_batch()
+  {
+    return ++batches;
+  }
+  /* END OF FUNCTION DEFINITION */
 
-      std::random_device rd;
-      std::mt19937_64 random_engine(rd());
-      //TO BE REINTEGRATED POTENTIALLY
-      //std::mt19937_64 random_engine(initial_seed);
 
-      attest(options.max_iterations >= 0 || options.max_time >= 0);
-      if (options.max_time >= 0) {
-      #ifndef USE_OPENMP
-	throw std::runtime_error("ComputeOptions::max_time requires OpenMP.");
-      #endif
-      }
 
-      // Will support more players later.
-      attest(root_state.player_to_move == 1 || root_state.player_to_move == 2);
-      auto root = std::unique_ptr<Node<State>>(new Node<State>(root_state));
+  /* Function to queue a job of a batch, returning the future of its 
+     result */
+  template<typename Function>
+    std::future<typename std::result_of<Function()>::type> 
+    ThreadPool::submit(Function function, Batch batch)
+    {
+      typedef typename std::result_of<Function()>::type Result;
+      // std::function needs a copyable target, the task is shared.
+      auto task = std::make_shared<std::packaged_task<Result()>>(function);
+      auto future = task->get_future();
+      {
+	std::lock_guard<std::mutex> lock(mutex);
+	jobs.push_back(std::make_pair(batch, [task]() { (*task)(); }));
+      }
+      job_added.notify_one();
+      return future;
+    }
+  /* END OF FUNCTION DEFINITION */
 
-      #ifdef USE_OPENMP
-        double start_time = ::omp_get_wtime();
-        double print_time = start_time;
-      #endif
 
 
-      /* MCTS cycle - selection, expansion, simulation, backpropagation */
-      for (int iter = 1; iter <= options.max_iterations || 
-	     options.max_iterations < 0; ++iter) {
-	auto node = root.get();
-	State state = root_state;
-	level_counter = 0; //restart from root;
+  /* Function to wait until the results of the jobs of a batch are ready,
+     before their futures are read. The waiting thread runs the queued jobs
+     of the batch until there are none left, then blocks: the jobs waited 
+     for are by then running in other threads. */
+  template<typename Result>
+    void ThreadPool::wait_all(const std::vector<std::future<Result>>& 
+			      futures, Batch batch)
+    {
+      for (auto& future: futures) {
+	wait(future, batch);
+      }
+    }
+  /* END OF FUNCTION DEFINITION */
 
-	// Select a path through the tree to a leaf node.
-	while (!node->has_untried_moves() && node->has_children() && 
-	       level_counter < max_level) {
-	  node = node->select_child_UCT();
-	  state.do_move(node->move);
-	  level_counter++;
-	}
 
-	// If we are not already at the final state, expand the
-	// tree with a new node and move there.
-	if (node->has_untried_moves() && level_counter < max_level) {
-	  auto move = node->get_untried_move(&random_engine);
-	  state.do_move(move);
-	  node = node->add_child(move, state);
-	  level_counter++;
-	}
 
-	// We now play randomly until the game ends.
-	while (state.has_moves()) {
-	  state.do_random_move(&random_engine);
+  /* Same as wait_all, for one future */
+  template<typename Future>
+    void ThreadPool::wait(const Future& future, Batch batch)
+    {
+      while (future.wait_for(std::chrono::seconds(0)) != 
+	     std::future_status::ready) {
+	if ( ! run_pending_job(batch)) {
+	  future.wait();
 	}
+      }
+    }
+  /* END OF FUNCTION DEFINITION */
 
-	// We have now reached a final state. Backpropagate the result
-	// up the tree to the root node.
-	while (node != nullptr) {
-	  node->update(state.get_result(node->player_to_move));
-	  node = node->parent;
-	}
 
-	
-	#ifdef USE_OPENMP
-	if (options.verbose || options.max_time >= 0) {
-          double time = ::omp_get_wtime();
-          if (options.verbose && (time - print_time >= 1.0 || 
-				  iter == options.max_iterations)) {
-            std::cerr << iter << " games played (";
-	    std::cerr << double(iter) / (time - start_time);
-	    std::cerr << " / second)." << endl;
-	    print_time = time;
-          }
-	
 
-	  if (time - start_time >= options.max_time) {
-            break;
-	  }
-        }
-	#endif
-	
+  /* Function to run the first queued job of a batch, if any. Returns 
+     false if there was none. */
+  inline bool ThreadPool::run_pending_job(Batch batch)
+  {
+    std::function<void()> job;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto itr = jobs.begin();
+      while (itr != jobs.end() && itr->first != batch) {
+	++itr;
       }
+      if (itr == jobs.end()) {
+	return false;
+      }
+      job = std::move(itr->second);
+      jobs.erase(itr);
+    }
+    job();
+    return true;
+  }
+  /* END OF FUNCTION DEFINITION */
 
 
-      /* Part to print the tree */
-      /*std::ofstream out;
-      string filename = "Sight_";
-      filename += (char)(max_level + '0');
-      filename += "/Tree_capped.txt";
-      out.open(filename);
-      out << root->tree_to_string(8,0);
-      out.close();*/
-      /* Part to print the tree */
 
+  /* Loop of the worker threads, first bound to core cpu unless it is -1 */
+  inline void ThreadPool::work(int cpu)
+  {
+  #ifdef __linux__
+    if (cpu >= 0) {
+      cpu_set_t core;
+      CPU_ZERO(&core);
+      CPU_SET(cpu, &core);
+      is_pinned_worker() = 
+	pthread_setaffinity_np(pthread_self(), sizeof(core), &core) == 0;
+    }
+  #endif
 
-      return root;
+    while (true) {
+      std::function<void()> job;
+      {
+	std::unique_lock<std::mutex> lock(mutex);
+	job_added.wait(lock, [this]() { return stopping || ! jobs.empty(); });
+	if (jobs.empty()) {
+	  return;
+	}
+	job = std::move(jobs.front().second);
+	jobs.pop_front();
+      }
+      job();
     }
+  }
   /* END OF FUNCTION DEFINITION */
 
 
 
-  /* Function to compute the tree with the MCTS algorithm. 
-     Used by compute_move_adapt.
-     ADAPTATIVE version - Uses sight inferred to infer moves of opponent */
-  template<typename State>
-    std::unique_ptr<Node<State>> compute_tree_adapt(const State root_state,
-	                                            const ComputeOptions options,
-	                                            std::mt19937_64::result_type
-	                                            initial_seed,
-						    const int sight_inferred,
-						    const int max_sight)
-    {
-      int level_counter = 0;
-
-      std::random_device rd;
-      std::mt19937_64 random_engine(rd());
-      //TO BE REINTEGRATED POTENTIALLY
-      //std::mt19937_64 random_engine(initial_seed);
+  /* Number of workers of the engine-wide pool, 0 until configured */
+  inline int& thread_pool_size()
+  {
+    static int size = 0;
+    return size;
+  }
+  /* END OF FUNCTION DEFINITION */
 
-      attest(options.max_iterations >= 0 || options.max_time >= 0);
-      if (options.max_time >= 0) {
-      #ifndef USE_OPENMP
-	throw std::runtime_error("ComputeOptions::max_time requires OpenMP.");
-      #endif
-      }
 
-      // Will support more players later.
-      attest(root_state.player_to_move == 1 || root_state.player_to_move == 2);
-      auto root = std::unique_ptr<Node<State>>(new Node<State>(root_state));
 
-      #ifdef USE_OPENMP
-        double start_time = ::omp_get_wtime();
-        double print_time = start_time;
-      #endif
+  /* Whether the workers of the engine-wide pool are bound to cores */
+  inline bool& thread_pool_pinned()
+  {
+    static bool pinned = false;
+    return pinned;
+  }
+  /* END OF FUNCTION DEFINITION */
 
 
-      /* MCTS cycle - selection, expansion, simulation, backpropagation */
-      for (int iter = 1; iter <= options.max_iterations || 
-	     options.max_iterations < 0; ++iter) {
-	auto node = root.get();
-	State state = root_state;
-	level_counter = 0; //restart from root;
-	
-	// Select a path through the tree to a leaf node.
-	// This time also taking into account opponent's inferred moves
-	// and deleting those children that do not correspond to those moves
-	while (!node->has_untried_moves() && node->has_children()) {
-	  auto parent_node = node;
-	  node = node->select_child_UCT();
-	  if (level_counter == 1) {
-	    
-	    // Infer move and set it for parent if not yet
-	    if (parent_node->move_inferred == -1) {
-	      vector<typename State::Move> subtree_sight_arr = sight_array(state, 
-							     max_sight, options);
-	      typename State::Move move_inf = subtree_sight_arr[sight_inferred
-								- 1];
-	      parent_node->move_inferred = move_inf;
-	    }
 
-	    // Delete unwanted children - indirect tree pruning.
-	    if (node->move != parent_node->move_inferred){
-	      delete node;
-	      auto child_iter = parent_node->children.begin();
-	      for (;child_iter != parent_node->children.end(); ++ child_iter){
-		if (*child_iter == node) {
-		  parent_node->children.erase(child_iter);
-		  break;
-		}
-	      }
-	      node = root.get();
-	      level_counter = 0;
-	      state = root_state;
-	      continue;
-	    }
-	  }
-	  
-	  state.do_move(node->move);
-	  level_counter++;
-	}
+  /* Function to get the engine-wide pool, used by every search. It is 
+     started on first use, with the size set by configure_thread_pool, one
+     worker per hardware thread by default. */
+  inline ThreadPool& thread_pool()
+  {
+    static ThreadPool pool([]() 
+			   {
+			     if (thread_pool_size() == 0) {
+			       thread_pool_size() = std::max(1, int(
+				 std::thread::hardware_concurrency()));
+			     }
+			     return thread_pool_size();
+			   }(), thread_pool_pinned());
+    return pool;
+  }
+  /* END OF FUNCTION DEFINITION */
 
 
-	// If we are not already at the final state, expand the
-	// tree with a new node and move there.
-	if (node->has_untried_moves()) {
-	  auto move = node->get_untried_move(&random_engine);
-	  state.do_move(move);
-	  node = node->add_child(move, state);
-	}
 
-	// We now play randomly until the game ends.
-	while (state.has_moves()) {
-	  state.do_random_move(&random_engine);
-	}
+  /* Function to set the number of workers of the engine-wide pool, once,
+     before the first search, and whether to bind them to cores. */
+  inline void configure_thread_pool(int threads, bool pin_workers = false)
+  {
+    check(thread_pool_size() == 0, "The thread pool is already configured.");
+    check(threads >= 1, "The thread pool needs at least one thread.");
+    thread_pool_size() = threads;
+    thread_pool_pinned() = pin_workers;
+  }
+  /* END OF FUNCTION DEFINITION */
 
-	// We have now reached a final state. Backpropagate the result
-	// up the tree to the root node.
-	while (node != nullptr) {
-	  node->update(state.get_result(node->player_to_move));
-	  node = node->parent;
-	}
 
-	
-	#ifdef USE_OPENMP
-	if (options.verbose || options.max_time >= 0) {
-	   double time = ::omp_get_wtime();
-	   if (options.verbose && (time - print_time >= 1.0 || 
-				   iter == options.max_iterations)) {
-             std::cerr << iter << " games played (";
-	     std::cerr << double(iter) / (time - start_time);
-	     std::cerr << " / second)." << endl;
-	     print_time = time;
-	   }
-	
 
-	   if (time - start_time >= options.max_time) {
-	     break;
-	   }
-	}
-	#endif
-	
+  /* Function to play several random games from the same leaf, for the 
+     SIMULATION phase, and return the sum of their results for player 1.
+     A single playout is played on state itself, as by random_playout. With
+     threads > 1 the playouts are shared with jobs of the thread pool, each
+     one with a random engine of its own, seeded from engine; the calling 
+     thread plays the first share. */
+  template<typename State, typename RandomEngine>
+    double random_playouts(State& state, int playouts, int threads, 
+			   RandomEngine* engine)
+    {
+      if (playouts == 1) {
+	return random_playout(state, engine);
       }
 
+      double results = 0;
+      threads = std::min(threads, playouts);
+      std::vector<std::future<double>> futures;
+      const auto batch = thread_pool().new_batch();
+      const State* leaf = &state;
+      for (int t = 1; t < threads; ++t) {
+	const std::uint64_t seed = (*engine)();
+	const int share = playouts * (t + 1) / threads - playouts * t / threads;
+	futures.push_back(thread_pool().submit([leaf, seed, share]()
+	  {
+	    RandomEngine thread_engine(seed);
+	    double sum = 0;
+	    for (int i = 0; i < share; ++i) {
+	      State playout_state = *leaf;
+	      sum += random_playout(playout_state, &thread_engine);
+	    }
+	    return sum;
+	  }, batch));
+      }
 
-      /* Part to print the tree */
-      /*std::ofstream out;
-      string filename = "Sight_";
-      filename += (char)(max_level + '0');
-      filename += "/Tree_capped.txt";
-      out.open(filename);
-      out << root->tree_to_string(8,0);
-      out.close();*/
-      /* Part to print the tree */
-
+      const int own_share = threads > 1 ? playouts / threads : playouts;
+      for (int i = 0; i < own_share; ++i) {
+	State playout_state = state;
+	results += random_playout(playout_state, engine);
+      }
 
-      return root;
+      thread_pool().wait_all(futures, batch);
+      for (auto& future: futures) {
+	results += future.get();
+      }
+      return results;
     }
   /* END OF FUNCTION DEFINITION */
 
 
 
+  /* Cache of the sight arrays computed by sight_array, keyed by the hash
+     of the position (with the sight and iterations asked for), set with 
+     ComputeOptions::sight_cache. It is shared by every thread searching 
+     with those options, and a sight array, once computed, is read by all
+     the later calls. The first thread asking for a position computes it, 
+     and the threads asking for it meanwhile block until its result is 
+     ready, without running jobs of the pool: such a job could be one the
+     computation waits for, held up below a job waiting for the position.
+     The computation itself asks for no sight array and only waits for its
+     own batches of jobs, which it runs itself if need be (see ThreadPool),
+     so the threads waiting are always released. A thread in the middle of
+     computing a position computes any other one it asks for rather than
+     wait, as the thread it would wait for might be waiting for it. */
+  class SightArrayCache
+  {
+  public:
+    template<typename Compute>
+      std::vector<int> find_or_compute(std::uint64_t hash, int max_sight, 
+				       int iterations, Compute compute);
+    std::size_t size();
+    void clear();
 
-  /* Function to compute a tree to evaluate the opponent with uniform node 
-     selection as opposed to UCT */
-  /* Function to compute the tree with the MCTS algorithm. 
-     Used by compute_move_unif.
-     UNIFORM version - Uses Uniform tree policy when descending the tree */
-  template<typename State>
-    std::unique_ptr<Node<State>>  compute_tree_unif(const State root_state,
-						    const ComputeOptions options,
-						    std::mt19937_64::result_type 
-						    initial_seed)
-    {
-
-      std::random_device rd;
-      std::mt19937_64 random_engine(rd());
-      //TO BE REINTEGRATED POTENTIALLY
-      //std::mt19937_64 random_engine(initial_seed);
-
-      attest(options.max_iterations >= 0 || options.max_time >= 0);
-      if (options.max_time >= 0) {
-      #ifndef USE_OPENMP
-	throw std::runtime_error("ComputeOptions::max_time requires OpenMP.");
-      #endif
-      }
+  private:
+    typedef std::tuple<std::uint64_t, int, int> Key;
 
-      // Will support more players later.
-      attest(root_state.player_to_move == 1 || root_state.player_to_move == 2);
-      auto root = std::unique_ptr<Node<State>>(new Node<State>(root_state));
+    // Positions being computed by the calling thread.
+    static int& computing()
+    {
+      static thread_local int positions = 0;
+      return positions;
+    }
 
-      #ifdef USE_OPENMP
-        double start_time = ::omp_get_wtime();
-        double print_time = start_time;
-      #endif
+    std::map<Key, std::shared_future<std::vector<int>>> entries;
+    std::mutex mutex;
+  };
 
 
-      for (int iter = 1; iter <= options.max_iterations || options.max_iterations < 0; ++iter) {
-	auto node = root.get();
-	State state = root_state;
 
-	// Select a path through the tree to a leaf node.
-	while (!node->has_untried_moves() && node->has_children()) {
-	  node = node->select_child_unif(&random_engine);
-	  state.do_move(node->move);
+  /* Function to get the sight array of a position from the cache, 
+     computing it with compute() if it is not there yet */
+  template<typename Compute>
+    std::vector<int> SightArrayCache::find_or_compute(std::uint64_t hash,
+						      int max_sight,
+						      int iterations,
+						      Compute compute)
+    {
+      const Key key(hash, max_sight, iterations);
+      std::shared_ptr<std::promise<std::vector<int>>> promise;
+      std::shared_future<std::vector<int>> result;
+      {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto itr = entries.find(key);
+	if (itr == entries.end()) {
+	  promise = std::make_shared<std::promise<std::vector<int>>>();
+	  result = promise->get_future().share();
+	  entries[key] = result;
+	}
+	else {
+	  result = itr->second;
 	}
+      }
 
-	// If we are not already at the final state, expand the
-	// tree with a new node and move there.
-	if (node->has_untried_moves()) {
-	  auto move = node->get_untried_move(&random_engine);
-	  state.do_move(move);
-	  node = node->add_child(move, state);
+      if (promise == nullptr) {
+	if (computing() == 0 || result.wait_for(std::chrono::seconds(0)) ==
+	    std::future_status::ready) {
+	  return result.get();
 	}
+	return compute();
+      }
 
-	// We now play randomly until the game ends.
-	while (state.has_moves()) {
-	  state.do_random_move(&random_engine);
+      // The waiting threads get the exception too, and the position is
+      // left for the later calls to try again.
+      ++computing();
+      try {
+	auto computed = compute();
+	--computing();
+	promise->set_value(computed);
+	return computed;
+      }
+      catch (...) {
+	--computing();
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  auto itr = entries.find(key);
+	  if (itr != entries.end() && 
+	      itr->second.wait_for(std::chrono::seconds(0)) != 
+	      std::future_status::ready) {
+	    entries.erase(itr);
+	  }
 	}
+	promise->set_exception(std::current_exception());
+	throw;
+      }
+    }
+  /* END OF FUNCTION DEFINITION */
 
-	// We have now reached a final state. Backpropagate the result
-	// up the tree to the root node.
-	while (node != nullptr) {
-	  node->update(state.get_result(node->player_to_move));
-	  node = node->parent;
 
-	}
 
+  /* Function to get the number of positions in the cache */
+  inline std::size_t SightArrayCache::size()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+  }
+  /* END OF FUNCTION DEFINITION */
 
-	   #ifdef USE_OPENMP
-	   if (options.verbose || options.max_time >= 0) {
-	     double time = ::omp_get_wtime();
-	     if (options.verbose && (time - print_time >= 1.0 || 
-				     iter == options.max_iterations)) {
-	       std::cerr << iter << " games played (";
-	       std::cerr << double(iter) / (time - start_time);
-	       std::cerr << " / second)." << endl;
-	       print_time = time;
-	     }
-	     
-	     if (time - start_time >= options.max_time) {
-	       break;
-	     }
-	   }
-           #endif
-
-
-      } //closes for 100k iter
-	
-      
-      /* Part to print tree */
-      /*std::ofstream out;
-      out.open("TreeFull.txt");
-      out << root->tree_to_string(3,0);
-      out.close();*/
-      /* Part to print tree */
 
-      return root;
-    }
+
+  /* Function to empty the cache, e.g. when a new game starts */
+  inline void SightArrayCache::clear()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+  }
   /* END OF FUNCTION DEFINITION */
 
 
 
+  /* Buffer keeping what a thread appends to the result files, one stream
+     per file, while it is installed for the thread (see ResultFile). Used
+     to play games in parallel: each game gets a buffer, and the buffers are
+     appended to the files at the end, in the order of the games. */
+  class ResultBuffer
+  {
+  public:
+    std::ostream& file(const std::string& filename);
+    void append_to_files() const;
 
-  /* Function to compute move the move the algorithm will make
-     UNCONSTRAINED version. */
-  template<typename State>
-    typename State::Move compute_move(const State root_state,
-				      const ComputeOptions options)
+    // Buffer installed for the calling thread, nullptr if none.
+    static ResultBuffer*& of_this_thread()
     {
-      using namespace std;
+      static thread_local ResultBuffer* buffer = nullptr;
+      return buffer;
+    }
 
-      // Will support more players later.
-      attest(root_state.player_to_move == 1 || root_state.player_to_move == 2);
+  private:
+    std::map<std::string, std::unique_ptr<std::stringstream>> files;
+  };
 
-      auto moves = root_state.get_moves();
-      attest(moves.size() > 0);
-      if (moves.size() == 1) {
-	return moves[0];
-      }
 
-      #ifdef USE_OPENMP
-        double start_time = ::omp_get_wtime();
-      #endif
 
-      // Start all jobs to compute trees.
-      vector<future<unique_ptr<Node<State>>>> root_futures;
-      ComputeOptions job_options = options;
-      job_options.verbose = false;
-      for (int t = 0; t < options.number_of_threads; ++t) {
-	auto func = [t,&root_state,&job_options]()->std::unique_ptr<Node<State>>
+  /* Stream appending to a result file, or to the buffer installed for the
+     thread if there is one */
+  class ResultFile : public std::ostream
+  {
+  public:
+    explicit ResultFile(const std::string& filename);
+
+  private:
+    std::filebuf file;
+  };
+
+
+
+  inline std::ostream& ResultBuffer::file(const std::string& filename)
+  {
+    auto& stream = files[filename];
+    if ( ! stream) {
+      stream.reset(new std::stringstream());
+    }
+    return *stream;
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  inline void ResultBuffer::append_to_files() const
+  {
+    for (auto& itr: files) {
+      std::ofstream out(itr.first, std::fstream::app);
+      out << itr.second->str();
+    }
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  inline ResultFile::ResultFile(const std::string& filename) :
+    std::ostream(nullptr)
+  {
+    auto buffer = ResultBuffer::of_this_thread();
+    if (buffer != nullptr) {
+      rdbuf(buffer->file(filename).rdbuf());
+    }
+    else {
+      file.open(filename, std::fstream::out | std::fstream::app);
+      rdbuf(&file);
+    }
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Bump-pointer arena owning all the nodes of one search tree. Memory is
+     carved out of large blocks and is only given back to the system when
+     the arena is destroyed, i.e. the whole tree is released at once.
+     Chunks handed back with release() are kept free, merged with the free
+     chunks next to them in the same block, and a later request takes the
+     smallest free chunk it fits in, the rest of which stays free: this is 
+     how collapsed subtrees are recycled under a memory budget, whatever 
+     the sizes of the blocks of children freed and asked for.
+     The blocks of a pinned worker of the thread pool are mapped afresh 
+     from the system rather than taken from the heap, whose memory may have
+     been touched first on another socket: their pages are then placed on 
+     the NUMA node of the worker, which is first to touch them. */
+  const std::size_t ARENA_BLOCK_SIZE = 1 << 20;
+
+  class NodeArena
+  {
+  public:
+    explicit NodeArena(std::size_t block_size = ARENA_BLOCK_SIZE);
+    ~NodeArena();
+
+    void* allocate(std::size_t bytes, std::size_t alignment);
+    void* allocate_synchronized(std::size_t bytes, std::size_t alignment);
+    void release(void* memory, std::size_t bytes);
+    std::size_t growth_for(std::size_t bytes, std::size_t alignment) const;
+    std::size_t bytes_reserved() const;
+
+  private:
+    NodeArena(const NodeArena&);
+    NodeArena& operator = (const NodeArena&);
+
+    struct Block
+    {
+      char* memory;
+      std::size_t size;
+      bool mapped;  // with mmap, see above
+    };
+
+    typedef std::set<std::pair<std::size_t, char*>>::const_iterator 
+      FreeChunk;
+
+    char* new_block(std::size_t size);
+    FreeChunk find_free_chunk(std::size_t bytes, std::size_t alignment) 
+      const;
+    void add_free_chunk(char* chunk, std::size_t size);
+    void remove_free_chunk(FreeChunk chunk);
+
+    std::vector<Block> blocks;
+    std::set<char*> block_starts;
+    char* cursor;
+    char* block_end;
+    const std::size_t block_size;
+    // Free chunks by address, to merge them, and by size, to reuse them.
+    std::map<char*, std::size_t> free_chunks;
+    std::set<std::pair<std::size_t, char*>> free_sizes;
+    std::size_t free_bytes;
+    std::mutex mutex;  // only taken by allocate_synchronized
+  };
+
+
+
+  /* This Node class is used to build the game tree, it is its building block.
+     The root is created by the users and owns the arena from which
+     the rest of the tree is created by add_child. */
+
+  template<typename State>
+    class Node
+    {
+    public:
+      typedef typename State::Move Move;
+
+      /* The children of a node are constructed side by side in a single
+	 block, taken from the arena when the node is first expanded and
+	 sized to its number of legal moves. Walking the children (and their
+	 wins, visits and move, which lead each Node) is thus a linear scan.
+	 Children pruned by compute_tree_adapt keep their slot and are
+	 skipped. */
+      class Children
+      {
+      public:
+	class const_iterator
+	{
+	public:
+	  const_iterator(Node* node_, Node* last_) : node(node_), last(last_)
+	  {
+	    skip_pruned();
+	  }
+
+	  Node* operator * () const { return node; }
+
+	  const_iterator& operator ++ ()
+	  {
+	    ++node;
+	    skip_pruned();
+	    return *this;
+	  }
+
+	  bool operator == (const const_iterator& other) const
+	  {
+	    return node == other.node;
+	  }
+	  bool operator != (const const_iterator& other) const
+	  {
+	    return node != other.node;
+	  }
+
+	private:
+	  void skip_pruned()
+	  {
+	    while (node != last && node->pruned) ++node;
+	  }
+
+	  Node* node;
+	  Node* last;
+	};
+	typedef const_iterator iterator;
+
+	Children() : block(nullptr), used(0), live(0), capacity(0) { }
+
+	const_iterator begin() const 
+	{
+	  return const_iterator(block, block + used);
+	}
+	const_iterator end() const 
+	{
+	  return const_iterator(block + used, block + used);
+	}
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	std::size_t size() const { return live; }
+	bool empty() const { return live == 0; }
+	bool allocated() const { return block != nullptr; }
+
+	Node* operator [] (std::size_t i) const
+	{
+	  if (live == used) {
+	    return block + i;
+	  }
+	  auto itr = begin();
+	  for (; i > 0; --i) ++itr;
+	  return *itr;
+	}
+
+      private:
+	friend class Node;
+
+	Node* block;
+	int used;
+	int live;
+	int capacity;
+      };
+
+      Node(const State& state);
+
+      bool has_untried_moves() const;
+      int num_untried_moves() const;
+      template<typename RandomEngine>
+	Move get_untried_move(RandomEngine* engine) const;
+      Node* best_child() const;
+
+      bool has_children() const
+      {
+	return ! children.empty();
+      }
+
+      Node* select_child_UCT() const;
+      template<typename RandomEngine>
+	Node* select_child_unif(RandomEngine* engine) const;
+      Node* add_child(const Move& move, const State& state);
+      void prune_child(Node* child);
+      void restrict_to_move(const Move& move);
+      void link_transposition(Node* canonical);
+      std::uint64_t legal_moves() const;
+      std::size_t children_bytes() const;
+      std::size_t collapse();
+      void update(double result, int playouts = 1);
+      std::unique_ptr<Node> copy_subtree() const;
+
+      // Used by the threads sharing a tree, see grow_tree_shared.
+      bool try_expand_shared(const State& state, bool keep_untried = false);
+      template<typename RandomEngine>
+	Node* claim_untried_child(RandomEngine* engine);
+      bool is_expanded_shared() const
+      {
+	return expansion.load(std::memory_order_acquire) == expanded;
+      }
+      Node* select_child_UCT_shared() const;
+      void add_virtual_loss();
+      void update_shared(double result, int playouts = 1);
+
+      std::string to_string() const;
+      std::string tree_to_string(int max_depth = 1000000, int indent = 0) const;
+
+      // Statistics come first, they are what selection reads from each
+      // child of the block. They are atomic for the threads sharing a tree;
+      // a tree grown by a single thread only uses relaxed loads and stores,
+      // which cost the same as plain ones.
+      std::atomic<double> wins;
+      std::atomic<int> visits;
+      const Move move;
+      const int player_to_move;
+      bool pruned;
+
+    private:
+      // Expansion of a shared tree: claimed by one thread, then published.
+      enum { unexpanded, expanding, expanded };
+      std::atomic<char> expansion;
+
+      // Only set for the root, which owns the arena of the whole tree.
+      std::unique_ptr<NodeArena> owned_arena;
+
+    public:
+      NodeArena* const arena;
+      Node* const parent;
+
+      double score_from_below; 
+      int BI_depth;  // added to break ties in Back Induction
+      Move move_inferred;
+      
+      // In transposition mode, node of the tree already standing for the
+      // same position. This node then only keeps the statistics of the move
+      // leading to it and the search carries on from the linked node.
+      Node* transposition;
+      // Bit m is set if move m is untried. Atomic for the threads sharing
+      // a uniform tree, see compute_tree_unif_shared.
+      std::atomic<std::uint64_t> untried_moves;
+      Children children;
+
+    private:
+      Node(const State& state, const Move& move, Node* parent);
+      Node(const Node& source, Node* parent);
+      void copy_children(const Node& source);
+
+      std::string indent_string(int indent) const;
+      Node* select_child_UCT_scalar() const;
+      #ifdef MCTS_SIMD_UCT
+      Node* select_child_UCT_SIMD() const;
+      #endif
+
+      Node(const Node&);
+      Node& operator = (const Node&);
+    };
+
+
+  /////////////////////////////////////////////////////////
+  /////////////////////////////////////////////////////////
+
+  /**************************************************************/
+  /* BEGIN OF PART FOR FUNCTION DECLARATIONS FOR THE NODE CLASS */
+  /**************************************************************/
+
+								
+  /* Member functions of the arena */
+  inline NodeArena::NodeArena(std::size_t block_size_) :
+    cursor(nullptr),
+    block_end(nullptr),
+    block_size(block_size_),
+    free_bytes(0)
+    { }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  inline NodeArena::~NodeArena()
+  {
+    for (auto block: blocks) {
+    #ifdef __linux__
+      if (block.mapped) {
+	munmap(block.memory, block.size);
+	continue;
+      }
+    #endif
+      delete [] block.memory;
+    }
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to get a new block of size bytes from the system */
+  inline char* NodeArena::new_block(std::size_t size)
+  {
+    Block block = {nullptr, size, false};
+  #ifdef __linux__
+    if (ThreadPool::is_pinned_worker()) {
+      void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, 
+			  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (memory != MAP_FAILED) {
+	block.memory = static_cast<char*>(memory);
+	block.mapped = true;
+      }
+    }
+  #endif
+    if (block.memory == nullptr) {
+      block.memory = new char[size];
+    }
+    blocks.push_back(block);
+    block_starts.insert(block.memory);
+    return block.memory;
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to find the smallest free chunk which can hold bytes at the
+     given alignment. Returns free_sizes.end() if there is none. */
+  inline NodeArena::FreeChunk NodeArena::find_free_chunk(
+    std::size_t bytes, std::size_t alignment) const
+  {
+    auto itr = free_sizes.lower_bound(std::make_pair(bytes, 
+						     (char*)nullptr));
+    for (; itr != free_sizes.end(); ++itr) {
+      std::uintptr_t address = reinterpret_cast<std::uintptr_t>(itr->second);
+      std::uintptr_t aligned = (address + alignment - 1) & ~(alignment - 1);
+      if (aligned + bytes <= address + itr->first) {
+	break;
+      }
+    }
+    return itr;
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to make a chunk free, merged with the free chunks right 
+     before and after it. Chunks of two blocks are never merged, even when
+     the blocks happen to be next to each other. */
+  inline void NodeArena::add_free_chunk(char* chunk, std::size_t size)
+  {
+    free_bytes += size;
+    auto next = free_chunks.lower_bound(chunk);
+    if (next != free_chunks.end() && next->first == chunk + size &&
+	block_starts.count(next->first) == 0) {
+      size += next->second;
+      free_sizes.erase(std::make_pair(next->second, next->first));
+      next = free_chunks.erase(next);
+    }
+    if (next != free_chunks.begin()) {
+      auto previous = std::prev(next);
+      if (previous->first + previous->second == chunk &&
+	  block_starts.count(chunk) == 0) {
+	chunk = previous->first;
+	size += previous->second;
+	free_sizes.erase(std::make_pair(previous->second, previous->first));
+	free_chunks.erase(previous);
+      }
+    }
+    free_chunks[chunk] = size;
+    free_sizes.insert(std::make_pair(size, chunk));
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to take a chunk out of the free ones */
+  inline void NodeArena::remove_free_chunk(FreeChunk chunk)
+  {
+    free_bytes -= chunk->first;
+    free_chunks.erase(chunk->second);
+    free_sizes.erase(chunk);
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Hands out the next suitably aligned chunk of the current block, opening
+     a new block when the current one is exhausted. */
+  inline void* NodeArena::allocate(std::size_t bytes, std::size_t alignment)
+  {
+    if (free_bytes >= bytes) {
+      auto itr = find_free_chunk(bytes, alignment);
+      if (itr != free_sizes.end()) {
+	char* chunk = itr->second;
+	char* chunk_end = chunk + itr->first;
+	remove_free_chunk(itr);
+	std::uintptr_t address = reinterpret_cast<std::uintptr_t>(chunk);
+	char* aligned = chunk + 
+	  (((address + alignment - 1) & ~(alignment - 1)) - address);
+	if (aligned != chunk) {
+	  add_free_chunk(chunk, aligned - chunk);
+	}
+	if (aligned + bytes != chunk_end) {
+	  add_free_chunk(aligned + bytes, chunk_end - (aligned + bytes));
+	}
+	return aligned;
+      }
+    }
+
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>(cursor);
+    std::uintptr_t aligned = (address + alignment - 1) & ~(alignment - 1);
+    if (cursor == nullptr || 
+	aligned + bytes > reinterpret_cast<std::uintptr_t>(block_end)) {
+      // The end of the current block is left free for smaller requests.
+      if (cursor != block_end) {
+	add_free_chunk(cursor, block_end - cursor);
+      }
+      std::size_t size = std::max(block_size, bytes + alignment);
+      cursor = new_block(size);
+      block_end = cursor + size;
+      address = reinterpret_cast<std::uintptr_t>(cursor);
+      aligned = (address + alignment - 1) & ~(alignment - 1);
+    }
+    cursor += (aligned - address) + bytes;
+    return reinterpret_cast<void*>(aligned);
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Same as allocate, for the threads expanding a shared tree together */
+  inline void* NodeArena::allocate_synchronized(std::size_t bytes, 
+						std::size_t alignment)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return allocate(bytes, alignment);
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to give a chunk back for reuse by later allocations */
+  inline void NodeArena::release(void* memory, std::size_t bytes)
+  {
+    add_free_chunk(static_cast<char*>(memory), bytes);
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function returning by how many bytes the arena would grow to serve
+     allocate(bytes, alignment): zero if a free chunk or the current block 
+     can take it. */
+  inline std::size_t NodeArena::growth_for(std::size_t bytes, 
+					   std::size_t alignment) const
+  {
+    if (free_bytes >= bytes && 
+	find_free_chunk(bytes, alignment) != free_sizes.end()) {
+      return 0;
+    }
+
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>(cursor);
+    std::uintptr_t aligned = (address + alignment - 1) & ~(alignment - 1);
+    if (cursor != nullptr &&
+	aligned + bytes <= reinterpret_cast<std::uintptr_t>(block_end)) {
+      return 0;
+    }
+    return std::max(block_size, bytes + alignment);
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  inline std::size_t NodeArena::bytes_reserved() const
+  {
+    std::size_t total = 0;
+    for (std::size_t i = 0; i + 1 < blocks.size(); ++i) {
+      total += blocks[i].size;
+    }
+    if ( ! blocks.empty()) {
+      total += block_end - blocks.back().memory;
+    }
+    return total;
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+  /* Constructor - the root creates the arena for the whole tree */
+  template<typename State>
+    Node<State>::Node(const State& state) : 
+    wins(0),
+    visits(0),
+    move(State::no_move),
+    player_to_move(state.player_to_move),
+    pruned(false),
+    expansion(unexpanded),
+    owned_arena(new NodeArena()),
+    arena(owned_arena.get()),
+    parent(nullptr),
+    score_from_below(-1),  // CA added
+    BI_depth(-1),          // CA added
+    move_inferred(-1),
+    transposition(nullptr),
+    untried_moves(legal_moves_mask(state))
+      { }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Overloaded Private Constructor - children share the arena of the root */
+  template<typename State>
+    Node<State>::Node(const State& state, const Move& move_, Node* parent_) :
+    wins(0),
+    visits(0),
+    move(move_),
+    player_to_move(state.player_to_move),
+    pruned(false),
+    expansion(unexpanded),
+    arena(parent_->arena),
+    parent(parent_),
+    score_from_below(-1),   // CA added
+    BI_depth(-1),           // CA added
+    move_inferred(-1),
+    transposition(nullptr),
+    untried_moves(legal_moves_mask(state))
+      { }
+  /* END OF FUNCTION DEFINITION */
+
+  /* Private Constructor copying the statistics of another node. Without a
+     parent, the copy becomes a root with an arena of its own. Links to
+     transpositions are not kept: such a node becomes an unexpanded one. */
+  template<typename State>
+    Node<State>::Node(const Node& source, Node* parent_) :
+    wins(source.wins.load()),
+    visits(source.visits.load()),
+    move(source.move),
+    player_to_move(source.player_to_move),
+    pruned(false),
+    expansion(unexpanded),
+    owned_arena(parent_ == nullptr ? new NodeArena() : nullptr),
+    arena(parent_ == nullptr ? owned_arena.get() : parent_->arena),
+    parent(parent_),
+    score_from_below(source.score_from_below),
+    BI_depth(source.BI_depth),
+    move_inferred(source.move_inferred),
+    transposition(nullptr),
+    untried_moves(source.transposition == nullptr ? 
+		  source.untried_moves.load() :
+		  source.transposition->legal_moves())
+      { }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  // There is no recursive destructor: all the nodes below the root are
+  // placed in the arena and their memory goes away with it, in one go,
+  // when the root is destroyed.
+
+
+
+  /* Function to check if a state has some moves available */
+  template<typename State>
+    bool Node<State>::has_untried_moves() const
+    {
+      return untried_moves.load(std::memory_order_relaxed) != 0;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  template<typename State>
+    int Node<State>::num_untried_moves() const
+    {
+      return count_bits(untried_moves.load(std::memory_order_relaxed));
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Get a random move to execute from a state */  
+  template<typename State>
+    template<typename RandomEngine>
+    typename State::Move Node<State>::get_untried_move(RandomEngine* 
+						       engine) const
+    {
+      std::uint64_t mask = untried_moves.load(std::memory_order_relaxed);
+      attest(mask != 0);
+      return Move(random_bit(mask, engine));
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to select the best child - based on number of visits */
+  template<typename State>
+    Node<State>* Node<State>::best_child() const
+    {
+      attest( ! has_untried_moves());
+      attest( ! children.empty() );
+
+      Node* best = nullptr;
+      for (auto child: children) {
+	if (best == nullptr || child->visits > best->visits) {
+	  best = child;
+	}
+      }
+      return best;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+
+  /* Function to implement UCT tree-selection policy. Built with 
+     USE_SIMD_UCT on a target with SSE2, the scores of the children are
+     computed two at a time, see select_child_UCT_SIMD. Debug builds then
+     check that the scalar path picks the same child. */
+  template<typename State>
+    Node<State>* Node<State>::select_child_UCT() const
+    {
+      attest( ! children.empty() );
+
+    #ifdef MCTS_SIMD_UCT
+      Node* best = select_child_UCT_SIMD();
+      dattest(best == select_child_UCT_scalar());
+      return best;
+    #else
+      return select_child_UCT_scalar();
+    #endif
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Scalar UCT selection: one pass over the child block, keeping the first
+     maximum. */
+  template<typename State>
+    Node<State>* Node<State>::select_child_UCT_scalar() const
+    {
+      const double log_visits = std::log(double(this->visits));
+      Node* best = nullptr;
+      double best_score = 0;
+      for (auto child: children) {
+	double score = double(child->wins) / double(child->visits) +
+	  std::sqrt(2.0 * log_visits / child->visits);
+	if (best == nullptr || score > best_score) {
+	  best = child;
+	  best_score = score;
+	}
+      }
+      return best;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+#ifdef MCTS_SIMD_UCT
+  /* SIMD UCT selection. The children are Node objects laid side by side, so
+     the wins and visits of two of them at a time are loaded into an SSE2
+     register and scored together, with the same operations as the scalar
+     path, and thus the same scores. A pruned slot scores -DBL_MAX and an 
+     odd last lane repeats the last child, which cannot win a tie. The 
+     lanes are then reduced to the first maximum, without branches. */
+  template<typename State>
+    Node<State>* Node<State>::select_child_UCT_SIMD() const
+    {
+      Node* block = children.block;
+      const int used = children.used;
+
+      const __m128d two_log_visits = 
+	_mm_set1_pd(2.0 * std::log(double(this->visits)));
+      const __m128d two = _mm_set1_pd(2.0);
+
+      __m128d best_score = _mm_set1_pd(-DBL_MAX);
+      __m128d best_index = _mm_setzero_pd();
+      __m128d index = _mm_set_pd(1.0, 0.0);
+
+      for (int first = 0; first < used; first += 2) {
+	const Node* low = block + first;
+	const Node* high = block + std::min(first + 1, used - 1);
+	__m128d wins = _mm_set_pd(high->pruned ? -DBL_MAX : 
+				  high->wins.load(std::memory_order_relaxed),
+				  low->pruned ? -DBL_MAX : 
+				  low->wins.load(std::memory_order_relaxed));
+	__m128d visits = _mm_cvtepi32_pd(_mm_set_epi32(0, 0, 
+	  high->visits.load(std::memory_order_relaxed),
+	  low->visits.load(std::memory_order_relaxed)));
+
+	__m128d score = 
+	  _mm_add_pd(_mm_div_pd(wins, visits),
+		     _mm_sqrt_pd(_mm_div_pd(two_log_visits, visits)));
+	__m128d better = _mm_cmpgt_pd(score, best_score);
+	best_score = _mm_or_pd(_mm_and_pd(better, score), 
+			       _mm_andnot_pd(better, best_score));
+	best_index = _mm_or_pd(_mm_and_pd(better, index), 
+			       _mm_andnot_pd(better, best_index));
+	index = _mm_add_pd(index, two);
+      }
+
+      // Maximum score over the lanes, then smallest index reaching it.
+      __m128d max_score = _mm_max_pd(best_score, 
+				     _mm_shuffle_pd(best_score, best_score, 1));
+      __m128d is_max = _mm_cmpeq_pd(best_score, max_score);
+      __m128d min_index = _mm_or_pd(_mm_and_pd(is_max, best_index),
+				    _mm_andnot_pd(is_max, 
+						  _mm_set1_pd(double(used))));
+      min_index = _mm_min_pd(min_index, 
+			     _mm_shuffle_pd(min_index, min_index, 1));
+      attest(_mm_cvtsd_f64(max_score) > -DBL_MAX);
+      return block + _mm_cvttsd_si32(min_index);
+    }
+  /* END OF FUNCTION DEFINITION */
+#endif
+
+
+
+
+  /* NEW FUNCTION - To select a child uniformly as opposed with UCT when 
+     descending the tree */
+  template<typename State>
+    template<typename RandomEngine>
+    Node<State>* Node<State>::select_child_unif(RandomEngine* engine) const
+    {
+      std::uniform_int_distribution<std::size_t> moves_distribution(0, 
+						       children.size() - 1);
+      return children[moves_distribution(*engine)];
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to add a child to a Node */
+  template<typename State>
+    Node<State>* Node<State>::add_child(const Move& move, const State& state)
+    {
+      // First expansion: reserve one slot per legal move.
+      if (children.block == nullptr) {
+	children.capacity = num_untried_moves();
+	void* memory = arena->allocate(children.capacity * sizeof(Node),
+				       alignof(Node));
+	children.block = static_cast<Node*>(memory);
+      }
+      attest(children.used < children.capacity);
+
+      auto node = new (children.block + children.used) Node(state, move, this);
+      children.used++;
+      children.live++;
+      attest( ! children.empty());
+
+      std::uint64_t bit = std::uint64_t(1) << move;
+      std::uint64_t untried = untried_moves.load(std::memory_order_relaxed);
+      attest((untried & bit) != 0);
+      untried_moves.store(untried & ~bit, std::memory_order_relaxed);
+      return node;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to take a child out of the tree. Its slot in the child block
+     is kept, flagged as pruned, and skipped from then on. */
+  template<typename State>
+    void Node<State>::prune_child(Node* child)
+    {
+      attest(child->parent == this && ! child->pruned);
+      child->pruned = true;
+      children.live--;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to keep a single move of a node, as for the inferred move of 
+     the opponent in compute_tree_adapt: the children of the other moves 
+     are pruned and their untried moves dropped, so that they are neither
+     selected nor expanded from then on. */
+  template<typename State>
+    void Node<State>::restrict_to_move(const Move& move)
+    {
+      std::uint64_t kept = 0;
+      if (0 <= move && move < 64) {
+	kept = std::uint64_t(1) << move;
+      }
+      untried_moves.store(untried_moves.load(std::memory_order_relaxed) & 
+			  kept, std::memory_order_relaxed);
+      for (auto child: children) {
+	if (child->move != move) {
+	  prune_child(child);
+	}
+      }
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to copy the subtree below a node into a new tree, with its
+     own arena. Pruned children are left out. Used to re-root a search: once
+     the copy is taken, the old tree (ancestors and siblings included) can be
+     released at once. */
+  template<typename State>
+    std::unique_ptr<Node<State>> Node<State>::copy_subtree() const
+    {
+      std::unique_ptr<Node> root(new Node(*this, nullptr));
+      root->copy_children(*this);
+      return root;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Recursive helper function to copy the children of source below this 
+     node, in a block of the same capacity. */
+  template<typename State>
+    void Node<State>::copy_children(const Node& source)
+    {
+      if (source.children.block == nullptr) {
+	return;
+      }
+
+      children.capacity = source.children.capacity;
+      void* memory = arena->allocate(children.capacity * sizeof(Node),
+				     alignof(Node));
+      children.block = static_cast<Node*>(memory);
+
+      for (auto source_child: source.children) {
+	auto node = new (children.block + children.used) Node(*source_child,
+							      this);
+	children.used++;
+	children.live++;
+	node->copy_children(*source_child);
+      }
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to link a freshly added node to the node already standing for
+     its position, in transposition mode */
+  template<typename State>
+    void Node<State>::link_transposition(Node* canonical)
+    {
+      attest( ! has_children() && canonical != this);
+      attest(canonical->player_to_move == player_to_move);
+      transposition = canonical;
+      untried_moves = 0;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to get back the legal moves of the position of the node, 
+     tried or not */
+  template<typename State>
+    std::uint64_t Node<State>::legal_moves() const
+    {
+      std::uint64_t mask = untried_moves;
+      for (auto child: children) {
+	mask |= std::uint64_t(1) << child->move;
+      }
+      return mask;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to compute the size of the block of children of the node,
+     allocated or to be allocated on its first expansion */
+  template<typename State>
+    std::size_t Node<State>::children_bytes() const
+    {
+      int capacity = children.allocated() ? children.capacity : 
+	num_untried_moves();
+      return capacity * sizeof(Node);
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to turn a node back into a leaf: the subtree below it is given
+     back to the arena and its moves become untried again, while the node 
+     keeps the statistics gathered so far. Returns the bytes released. */
+  template<typename State>
+    std::size_t Node<State>::collapse()
+    {
+      if (children.block == nullptr) {
+	return 0;
+      }
+
+      std::size_t released = children_bytes();
+      untried_moves = legal_moves();
+      for (auto child: children) {
+	released += child->collapse();
+      }
+      arena->release(children.block, children_bytes());
+      children = Children();
+      return released;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to backpropagate the result of a random playout, or the 
+     summed results of several playouts played from the same leaf */
+  template<typename State>
+    void Node<State>::update(double result, int playouts)
+    {
+      visits.store(visits.load(std::memory_order_relaxed) + playouts, 
+		   std::memory_order_relaxed);
+      wins.store(wins.load(std::memory_order_relaxed) + result, 
+		 std::memory_order_relaxed);
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to expand a node of a shared tree with all its children at
+     once. Only the thread which claims the node does it, the others carry
+     on without waiting; the children are then published together, and are
+     never changed from then on, so that the threads can walk them without
+     locks once is_expanded_shared() holds. Returns true if this thread 
+     expanded the node. With keep_untried, the moves of the children stay 
+     untried until claimed with claim_untried_child. */
+  template<typename State>
+    bool Node<State>::try_expand_shared(const State& state, 
+					bool keep_untried)
+    {
+      char expected = unexpanded;
+      if ( ! expansion.compare_exchange_strong(expected, expanding,
+					       std::memory_order_acquire)) {
+	return false;
+      }
+
+      const std::uint64_t legal = untried_moves.load();
+      if (legal != 0) {
+	children.capacity = count_bits(legal);
+	void* memory = 
+	  arena->allocate_synchronized(children.capacity * sizeof(Node),
+				       alignof(Node));
+	children.block = static_cast<Node*>(memory);
+	for (auto moves = legal; moves != 0; moves &= moves - 1) {
+	  Move move = Move(lowest_bit(moves));
+	  State child_state = state;
+	  child_state.do_move(move);
+	  add_child(move, child_state);
+	}
+	if (keep_untried) {
+	  untried_moves.store(legal, std::memory_order_relaxed);
+	}
+      }
+      expansion.store(expanded, std::memory_order_release);
+      return true;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to claim one of the untried moves of a node of a shared 
+     tree, expanded with keep_untried, drawn at random as get_untried_move
+     does. Each move is claimed by one thread only. Returns the child of 
+     the move, or nullptr when no move is left untried. */
+  template<typename State>
+    template<typename RandomEngine>
+    Node<State>* Node<State>::claim_untried_child(RandomEngine* engine)
+    {
+      std::uint64_t mask = untried_moves.load(std::memory_order_relaxed);
+      while (mask != 0) {
+	const int move = random_bit(mask, engine);
+	if (untried_moves.compare_exchange_weak(mask, 
+						mask & ~(std::uint64_t(1) << 
+							 move),
+						std::memory_order_relaxed)) {
+	  // Every legal move has its child, in the order of the moves.
+	  Node* child = children.block;
+	  while (child->move != move) {
+	    ++child;
+	  }
+	  return child;
+	}
+      }
+      return nullptr;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* UCT selection in a shared tree. The children all exist from the 
+     expansion on, the unvisited ones are taken first, in order (a visit in
+     progress in another thread already counts, see add_virtual_loss). */
+  template<typename State>
+    Node<State>* Node<State>::select_child_UCT_shared() const
+    {
+      attest( ! children.empty() );
+
+      const double log_visits = 
+	std::log(double(visits.load(std::memory_order_relaxed)));
+      Node* best = nullptr;
+      double best_score = 0;
+      for (auto child: children) {
+	int child_visits = child->visits.load(std::memory_order_relaxed);
+	if (child_visits == 0) {
+	  return child;
+	}
+	double score = child->wins.load(std::memory_order_relaxed) / 
+	  child_visits + std::sqrt(2.0 * log_visits / child_visits);
+	if (best == nullptr || score > best_score) {
+	  best = child;
+	  best_score = score;
+	}
+      }
+      return best;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to count a visit of a shared tree as soon as the node is 
+     selected: until the result comes back with update_shared, the visit is
+     a loss, which steers the other threads away from the same path. */
+  template<typename State>
+    void Node<State>::add_virtual_loss()
+    {
+      visits.fetch_add(1, std::memory_order_relaxed);
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to backpropagate the result of a visit counted by 
+     add_virtual_loss, or the summed results of its playouts when it 
+     played several, the first one being already counted */
+  template<typename State>
+    void Node<State>::update_shared(double result, int playouts)
+    {
+      if (playouts > 1) {
+	visits.fetch_add(playouts - 1, std::memory_order_relaxed);
+      }
+      double current = wins.load(std::memory_order_relaxed);
+      while ( ! wins.compare_exchange_weak(current, current + result,
+					   std::memory_order_relaxed)) {
+      }
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Helper function to convert a Node to a printable format, used to print
+     the tree */
+  template<typename State>
+    std::string Node<State>::to_string() const
+    {
+      std::stringstream sout;
+      sout << "["
+	   << "P" << 3 - player_to_move << " "
+	   << "M:" << move << " "
+	   << "W/V: " << wins << "/" << visits << " "
+	   << "%_win: " << setprecision(2) << fixed << wins/visits << ", " 
+	   << "SFB: " << setprecision(2) << fixed << score_from_below << ", "
+	   << "MI: " << move_inferred << ", "
+	   << "U: " << num_untried_moves() << "]\n";
+      return sout.str();
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to turn a tree to a string to print it */
+  template<typename State>
+    std::string Node<State>::tree_to_string(int max_depth, int indent) const
+    {
+      if (indent >= max_depth) {
+	return "";
+      }
+
+      std::string s = indent_string(indent) + to_string();
+      for (auto child: children) {
+	s += child->tree_to_string(max_depth, indent + 1);
+      }
+      return s;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Helper function to create indents when printing the tree */
+  template<typename State>
+    std::string Node<State>::indent_string(int indent) const
+    {
+      std::string s = "";
+      for (int i = 1; i <= indent; ++i) {
+	s += "| ";
+      }
+      return s;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+  /**************************************************************/
+  /* END OF PART FOR FUNCTION DECLARATIONS FOR THE NODE CLASS */
+  /**************************************************************/
+
+  /////////////////////////////////////////////////////////
+  /////////////////////////////////////////////////////////
+
+
+  /* Function to collapse the least visited subtrees of a tree, leaving
+     alone the path from the root to keep, until at least bytes_wanted have
+     been given back to the arena. Deeper nodes have fewer visits than their
+     ancestors, so the coldest fringe of the tree goes first. */
+  template<typename State>
+    void collapse_coldest_subtrees(Node<State>* root, Node<State>* keep,
+				   std::size_t bytes_wanted)
+    {
+      vector<Node<State>*> path;
+      for (auto node = keep; node != nullptr; node = node->parent) {
+	path.push_back(node);
+      }
+
+      vector<Node<State>*> candidates;
+      vector<Node<State>*> stack(1, root);
+      while ( ! stack.empty()) {
+	auto node = stack.back();
+	stack.pop_back();
+	for (auto child: node->children) {
+	  if (child->has_children()) {
+	    candidates.push_back(child);
+	    stack.push_back(child);
+	  }
+	}
+      }
+      std::stable_sort(candidates.begin(), candidates.end(),
+		       [](Node<State>* a, Node<State>* b) {
+			 return a->visits < b->visits;
+		       });
+
+      std::size_t released = 0;
+      for (auto node: candidates) {
+	if (released >= bytes_wanted) {
+	  break;
+	}
+	if (std::find(path.begin(), path.end(), node) == path.end()) {
+	  released += node->collapse();
+	}
+      }
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Share of options.max_memory reclaimed at once by fits_memory_budget,
+     which walks the whole tree each time: the tree is kept between 7/8 of
+     the budget and the budget, and is walked once per 1/8 of the budget 
+     taken by new nodes. */
+  const int MEMORY_RECLAIM_DIVISOR = 8;
+
+  /* Function to check that expanding node keeps the tree within 
+     options.max_memory. When it would not, the memory the expansion needs,
+     and at least 1/MEMORY_RECLAIM_DIVISOR of the budget, is first 
+     reclaimed from the coldest subtrees (except in transposition mode). 
+     Since free chunks are merged and split by the arena, this only happens
+     once the free memory of the arena falls short of the need. Returns 
+     false if the node has to remain a leaf for now. The root is always 
+     expanded, the budget being at least a block of the arena (see 
+     Search::grow), so that the search has moves to choose from. */
+  template<typename State>
+    bool fits_memory_budget(Node<State>* root, Node<State>* node,
+			    const ComputeOptions& options)
+    {
+      if (options.max_memory < 0 || node == root || 
+	  node->children.allocated()) {
+	return true;
+      }
+
+      auto arena = root->arena;
+      const std::size_t budget = std::size_t(options.max_memory);
+      const std::size_t bytes = node->children_bytes();
+      if (arena->bytes_reserved() + 
+	  arena->growth_for(bytes, alignof(Node<State>)) <= budget) {
+	return true;
+      }
+
+      // Linked nodes and the table would be left dangling by collapsing, in
+      // transposition mode the tree simply stops growing.
+      if ( ! options.use_transpositions) {
+	collapse_coldest_subtrees(root, node, 
+				  std::max(bytes, budget / 
+					   MEMORY_RECLAIM_DIVISOR));
+      }
+      return arena->bytes_reserved() + 
+	arena->growth_for(bytes, alignof(Node<State>)) <= budget;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to check whether the choice of the move at root is decided,
+     for the early termination of ComputeOptions::early_stop_interval. The
+     move is chosen by its expected success rate (w + 1) / (v + 2), the 
+     mean of its Beta posterior (see merge_root_children). It is decided
+     when the lead of the best rate over the runner-up is more than 
+     options.early_stop_z standard deviations of the two posteriors, or 
+     when the runner-up could not catch up even if it won all the 
+     games_left (unknown if negative) while the best move lost them all.
+     Every move must have been tried at least once. */
+  template<typename State>
+    bool search_is_decided(const Node<State>* root, 
+			   const ComputeOptions& options, long long games_left)
+    {
+      if (root->has_untried_moves()) {
+	return false;
+      }
+
+      const Node<State>* best = nullptr;
+      const Node<State>* runner_up = nullptr;
+      double best_rate = -1;
+      double runner_up_rate = -1;
+      for (auto child: root->children) {
+	double rate = (child->wins + 1) / (child->visits + 2);
+	if (rate > best_rate) {
+	  runner_up = best;
+	  runner_up_rate = best_rate;
+	  best = child;
+	  best_rate = rate;
+	}
+	else if (rate > runner_up_rate) {
+	  runner_up = child;
+	  runner_up_rate = rate;
+	}
+      }
+      if (runner_up == nullptr) {
+	return false;
+      }
+
+      // Variance of a Beta(w + 1, v - w + 1) posterior.
+      auto variance = [](double rate, double visits)
+	{
+	  return rate * (1 - rate) / (visits + 3);
+	};
+      double spread = std::sqrt(variance(best_rate, best->visits) + 
+				variance(runner_up_rate, runner_up->visits));
+      if (best_rate - runner_up_rate > options.early_stop_z * spread) {
+	return true;
+      }
+
+      if (games_left >= 0) {
+	double best_worst_rate = (best->wins + 1) / 
+	  (best->visits + games_left + 2);
+	for (auto child: root->children) {
+	  if (child != best && 
+	      (child->wins + games_left + 1) / 
+	      (child->visits + games_left + 2) >= best_worst_rate) {
+	    return false;
+	  }
+	}
+	return true;
+      }
+      return false;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to count the games a search checking for early termination
+     has played since its last check, and to tell whether it may stop, iter
+     being the last game played. The games it then saves are added to 
+     options.early_stop_saved, if set. */
+  template<typename State>
+    bool stop_early(const Node<State>* root, const ComputeOptions& options,
+		    int iter, int playouts, int& games_since_check)
+    {
+      if (options.early_stop_interval <= 0) {
+	return false;
+      }
+      games_since_check += playouts;
+      if (games_since_check < options.early_stop_interval) {
+	return false;
+      }
+      games_since_check = 0;
+
+      long long games_left = options.max_iterations < 0 ? -1 :
+	options.max_iterations - iter;
+      if ( ! search_is_decided(root, options, games_left)) {
+	return false;
+      }
+      if (games_left > 0 && options.early_stop_saved != nullptr) {
+	*options.early_stop_saved += games_left;
+      }
+      return true;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Table of the statistics of the root children, shared by the trees of
+     compute_move with ComputeOptions::root_sync_interval. Every so often,
+     each tree publishes the games it played itself below each root child,
+     and takes in those the other trees published, so that the selection
+     at its root counts the games of all the trees. The imported games are
+     withdrawn once the tree is done, so that merge_root_children counts 
+     every game once. There is no barrier: each tree synchronizes on its 
+     own schedule, whether or not the others are running. */
+  template<typename State>
+    class RootStatistics
+    {
+    public:
+      typedef typename State::Move Move;
+
+      struct Statistics
+      {
+	double wins;
+	int visits;
+
+      Statistics() : wins(0), visits(0) { }
+      };
+
+      // What one tree has exchanged with the table so far.
+      struct Share
+      {
+	std::map<Move, Statistics> published;
+	std::map<Move, Statistics> imported;
+	int root_published;
+	int root_imported;
+
+      Share() : root_published(0), root_imported(0) { }
+      };
+
+      RootStatistics() : root_visits(0) { }
+
+      void synchronize(Node<State>* root, Share& share);
+      void withdraw(Node<State>* root, const Share& share) const;
+
+    private:
+      std::mutex mutex;
+      std::map<Move, Statistics> totals;
+      int root_visits;
+    };
+
+
+
+  /* Function to publish the games of a tree below its root children since
+     the last synchronization, and to set the statistics of the root and of
+     its children to the totals of all the trees. */
+  template<typename State>
+    void RootStatistics<State>::synchronize(Node<State>* root, Share& share)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      for (auto child: root->children) {
+	Statistics& published = share.published[child->move];
+	Statistics& imported = share.imported[child->move];
+	Statistics& total = totals[child->move];
+	const double wins = child->wins.load(std::memory_order_relaxed);
+	const int visits = child->visits.load(std::memory_order_relaxed);
+
+	Statistics own;
+	own.wins = wins - imported.wins;
+	own.visits = visits - imported.visits;
+	total.wins += own.wins - published.wins;
+	total.visits += own.visits - published.visits;
+	published = own;
+
+	child->wins.store(total.wins, std::memory_order_relaxed);
+	child->visits.store(total.visits, std::memory_order_relaxed);
+	imported.wins = total.wins - own.wins;
+	imported.visits = total.visits - own.visits;
+      }
+
+      const int own_visits = root->visits.load(std::memory_order_relaxed) - 
+	share.root_imported;
+      root_visits += own_visits - share.root_published;
+      share.root_published = own_visits;
+      root->visits.store(root_visits, std::memory_order_relaxed);
+      share.root_imported = root_visits - own_visits;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to take the games imported by synchronize out of a tree */
+  template<typename State>
+    void RootStatistics<State>::withdraw(Node<State>* root, 
+					 const Share& share) const
+    {
+      for (auto child: root->children) {
+	auto imported = share.imported.find(child->move);
+	if (imported != share.imported.end()) {
+	  child->wins.store(child->wins.load(std::memory_order_relaxed) - 
+			    imported->second.wins, std::memory_order_relaxed);
+	  child->visits.store(child->visits.load(std::memory_order_relaxed) -
+			      imported->second.visits, 
+			      std::memory_order_relaxed);
+	}
+      }
+      root->visits.store(root->visits.load(std::memory_order_relaxed) - 
+			 share.root_imported, std::memory_order_relaxed);
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* POLICIES OF THE SEARCH ENGINE - see Search below. They are resolved at
+     compile time, so that their calls are inlined in the MCTS cycle. */
+
+  /* Selection by the UCT formula */
+  struct UCTSelection
+  {
+    template<typename State>
+      Node<State>* select(Node<State>* node, RandomGenerator* engine) const
+      {
+	return node->select_child_UCT();
+      }
+  };
+
+  /* Uniform selection, used to evaluate the opponent */
+  struct UniformSelection
+  {
+    template<typename State>
+      Node<State>* select(Node<State>* node, RandomGenerator* engine) const
+      {
+	return node->select_child_unif(engine);
+      }
+  };
+
+  /* Expansion of the whole tree */
+  struct FullExpansion
+  {
+    bool allows(int level) const
+    {
+      return true;
+    }
+  };
+
+  /* Expansion down to depth cap, counted from the root */
+  struct CappedExpansion
+  {
+    int cap;
+
+  CappedExpansion(int cap_) : cap(cap_) { }
+
+    bool allows(int level) const
+    {
+      return level < cap;
+    }
+  };
+
+  /* Hooks doing nothing */
+  struct NoHooks
+  {
+    template<typename State>
+      void visit(Node<State>* node, const State& state, int level,
+		 const ComputeOptions& options, const Deadline& deadline)
+      { }
+
+    template<typename State>
+      bool after_game(Node<State>* root, const ComputeOptions& options,
+		      int games, int playouts)
+      {
+	return false;
+      }
+
+    template<typename State>
+      void finish(Node<State>* root)
+      { }
+  };
+
+  /* Hooks for the early termination of options.early_stop_interval and,
+     with root_statistics, the synchronization of the root children with 
+     the other trees every options.root_sync_interval games. */
+  template<typename State>
+    class EarlyStopHooks : public NoHooks
+    {
+    public:
+      EarlyStopHooks(RootStatistics<State>* root_statistics_ = nullptr) :
+	root_statistics(root_statistics_),
+	games_since_sync(0),
+	games_since_check(0)
+	{ }
+
+      bool after_game(Node<State>* root, const ComputeOptions& options,
+		      int games, int playouts)
+      {
+	if (root_statistics != nullptr) {
+	  games_since_sync += playouts;
+	  if (games_since_sync >= options.root_sync_interval) {
+	    root_statistics->synchronize(root, root_share);
+	    games_since_sync = 0;
+	  }
+	}
+	return stop_early(root, options, games, playouts, games_since_check);
+      }
+
+      void finish(Node<State>* root)
+      {
+	if (root_statistics != nullptr) {
+	  root_statistics->withdraw(root, root_share);
+	}
+      }
+
+    private:
+      RootStatistics<State>* root_statistics;
+      typename RootStatistics<State>::Share root_share;
+      int games_since_sync;
+      int games_since_check;
+    };
+
+  /* Share of the time left to a search given to each sight array it 
+     computes: the search keeps time for the other sight arrays and its own
+     tree, and a sight array finished late (by a thread which ran other 
+     jobs while waiting, see ThreadPool) overruns the deadline little. */
+  const double SIGHT_TIME_SHARE = 0.25;
+
+  /* Hooks for the adaptative search: the first time a node of level 1 is 
+     reached, the opponent's move is inferred from its sight array and the
+     node restricted to it, so that the other moves are neither expanded 
+     nor selected - indirect tree pruning. The sight array is searched 
+     with SIGHT_TIME_SHARE of the time left before the deadline of the 
+     search, and no longer once it has passed. */
+  class InferenceHooks : public NoHooks
+  {
+  public:
+  InferenceHooks(int sight_inferred_, int max_sight_) :
+    sight_inferred(sight_inferred_),
+      max_sight(max_sight_)
+      { }
+
+    template<typename State>
+      void visit(Node<State>* node, const State& state, int level,
+		 const ComputeOptions& options, const Deadline& deadline)
+      {
+	if (level == 1 && node->move_inferred == -1 &&
+	    (node->has_untried_moves() || node->has_children()) &&
+	    ! deadline.expired()) {
+	  ComputeOptions sight_options = deadline.job_options(options);
+	  sight_options.max_time *= SIGHT_TIME_SHARE;
+	  vector<typename State::Move> subtree_sight_arr = 
+	    sight_array(state, max_sight, sight_options);
+	  typename State::Move move_inf = subtree_sight_arr[sight_inferred - 1];
+	  node->move_inferred = move_inf;
+	  node->restrict_to_move(move_inf);
+	}
+      }
+
+  private:
+    int sight_inferred;
+    int max_sight;
+  };
+
+
+
+  /* Single MCTS engine behind compute_tree, compute_tree_capped,
+     compute_tree_adapt and compute_tree_unif, which only differ by their
+     policies: SelectionPolicy picks the child to descend to, 
+     ExpansionPolicy tells whether the tree may grow below a level and 
+     Hooks are called on each node selected and after each game. The 
+     memory budget, transpositions, batched playouts, deadline and verbose
+     printing are the engine's own, for all the searches. */
+  template<typename State, typename SelectionPolicy, typename ExpansionPolicy,
+	   typename Hooks>
+    class Search
+    {
+    public:
+      Search(const ComputeOptions& options_, 
+	     SelectionPolicy selection_ = SelectionPolicy(),
+	     ExpansionPolicy expansion_ = ExpansionPolicy(),
+	     Hooks hooks_ = Hooks()) :
+	options(options_),
+	selection(selection_),
+	expansion(expansion_),
+	hooks(hooks_)
+	{ }
+
+      void grow(Node<State>* root, const State& root_state,
+		std::uint64_t initial_seed);
+      std::unique_ptr<Node<State>> compute_tree(const State& root_state,
+						std::uint64_t initial_seed);
+
+    private:
+      const ComputeOptions options;
+      SelectionPolicy selection;
+      ExpansionPolicy expansion;
+      Hooks hooks;
+    };
+
+
+
+  /* Function to grow a tree with the MCTS algorithm, starting from an 
+     existing root for root_state (possibly carrying statistics from a 
+     previous search). In transposition mode the tree becomes a DAG:
+     a position reached again by another order of moves is linked to the
+     node already standing for it, so that they share its statistics and
+     subtree. The result is thus backpropagated along the path taken rather
+     than through the parents. */
+  template<typename State, typename SelectionPolicy, typename ExpansionPolicy,
+	   typename Hooks>
+    void Search<State, SelectionPolicy, ExpansionPolicy, Hooks>::grow(
+      Node<State>* root, const State& root_state, std::uint64_t initial_seed)
+    {
+      RandomGenerator random_engine = make_random_generator(options, 
+							    initial_seed);
+
+      attest(options.max_iterations >= 0 || options.max_time >= 0);
+
+      // Will support more players later.
+      attest(root_state.player_to_move == 1 || root_state.player_to_move == 2);
+      attest(root->player_to_move == root_state.player_to_move);
+      check(has_hash<State>::value || ! options.use_transpositions,
+	    "ComputeOptions::use_transpositions requires State::get_hash().");
+      check(options.max_memory < 0 || 
+	    options.max_memory >= (long long)ARENA_BLOCK_SIZE,
+	    "ComputeOptions::max_memory is less than a block of the arena.");
+
+      // Transposition table, position hash to node.
+      std::unordered_map<std::uint64_t, Node<State>*> transpositions;
+      vector<Node<State>*> path;
+
+      Deadline deadline(options.max_time);
+      double print_time = 0;
+
+      /* MCTS cycle - selection, expansion, simulation, backpropagation */
+      for (int iter = 1, playouts = 0; iter <= options.max_iterations || 
+	     options.max_iterations < 0; iter += playouts) {
+	playouts = playouts_in_batch(options, iter);
+	
+	auto node = root;
+	State state = root_state;
+	int level = 0;
+	path.clear();
+	path.push_back(node);
+
+	// SELECTION - Select a path through the tree to a leaf node.
+	while (true) {
+	  hooks.visit(node, state, level, options, deadline);
+	  if (node->has_untried_moves() || !node->has_children() ||
+	      !expansion.allows(level)) {
+	    break;
+	  }
+	  node = selection.select(node, &random_engine);
+	  state.do_move(node->move);
+	  level++;
+	  if (node->transposition != nullptr) {
+	    path.push_back(node);
+	    node = node->transposition;
+	  }
+	  path.push_back(node);
+	}
+
+	// EXPANSION - If we are not already at the final state, expand the
+	// tree with a new node and move there, memory budget permitting.
+	if (node->has_untried_moves() && expansion.allows(level) &&
+	    fits_memory_budget(root, node, options)) {
+	  auto move = node->get_untried_move(&random_engine);
+	  state.do_move(move);
+	  node = node->add_child(move, state);
+	  path.push_back(node);
+
+	  if (options.use_transpositions) {
+	    auto& entry = transpositions[position_hash(state)];
+	    if (entry == nullptr) {
+	      entry = node;
+	    }
+	    else if (entry->player_to_move == node->player_to_move) {
+	      node->link_transposition(entry);
+	      node = entry;
+	      path.push_back(node);
+	    }
+	  }
+	}
+
+	// SIMULATION - We now play randomly until the game ends, playouts
+	// times, and backpropagate the summed results at once.
+	double result = random_playouts(state, playouts, options.leaf_threads,
+					&random_engine);
+
+	// BACKPROPAGATION - We have now reached a final state. 
+	// Backpropagate the result up the path to the root node.
+	for (auto path_node: path) {
+	  path_node->update(result_for(path_node->player_to_move, result,
+				       playouts), playouts);
+	}
+
+	if (hooks.after_game(root, options, iter + playouts - 1, playouts)) {
+	  break;
+	}
+
+	if (options.verbose) {
+	  double time = deadline.elapsed();
+	  if (time - print_time >= 1.0 ||
+	      iter + playouts > options.max_iterations) {
+	    std::cerr << iter + playouts - 1 << " games played (";
+	    std::cerr << double(iter + playouts - 1) / time
+		      << " / second).";
+	    std::cerr << endl;
+	    print_time = time;
+          }
+        }
+
+	if (deadline.passed(playouts)) {
+	  break;
+	}
+      }
+
+      hooks.finish(root);
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to compute a new tree for root_state. */
+  template<typename State, typename SelectionPolicy, typename ExpansionPolicy,
+	   typename Hooks>
+    std::unique_ptr<Node<State>> 
+    Search<State, SelectionPolicy, ExpansionPolicy, Hooks>::compute_tree(
+      const State& root_state, std::uint64_t initial_seed)
+    {
+      auto root = std::unique_ptr<Node<State>>(new Node<State>(root_state));
+      grow(root.get(), root_state, initial_seed);
+      return root;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to grow a tree with the MCTS algorithm, starting from an 
+     existing root for root_state (possibly carrying statistics from a 
+     previous search). Used by compute_tree and SearchSession.
+     Unconstrained version. With root_statistics, the root children are
+     synchronized with the other trees every options.root_sync_interval 
+     games. */
+  template<typename State>
+    void grow_tree(Node<State>* root, const State& root_state,
+		   const ComputeOptions options,
+		   std::uint64_t initial_seed,
+		   RootStatistics<State>* root_statistics = nullptr)
+    {
+      Search<State, UCTSelection, FullExpansion, EarlyStopHooks<State>>
+	search(options, UCTSelection(), FullExpansion(),
+	       EarlyStopHooks<State>(root_statistics));
+      search.grow(root, root_state, initial_seed);
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to compute the tree with the MCTS algorithm. 
+     Used by compute_move.
+     Unconstrained version. */
+  template<typename State>
+    std::unique_ptr<Node<State>>  compute_tree(const State root_state,
+					       const ComputeOptions options,
+					       std::uint64_t 
+					       initial_seed,
+					       RootStatistics<State>* 
+					       root_statistics = nullptr)
+    {
+      auto root = std::unique_ptr<Node<State>>(new Node<State>(root_state));
+      grow_tree(root.get(), root_state, options, initial_seed, 
+		root_statistics);
+      return root;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function run by each of the threads growing a shared tree with the 
+     MCTS algorithm ("tree parallelization"). Selection counts a virtual
+     loss on every node of the path, so that the threads spread over the
+     tree, and the result then only adds to the wins. A leaf is expanded 
+     with all its children at once by the first thread to reach it, the
+     others play out from the leaf meanwhile. Unconstrained version. */
+  template<typename State>
+    void grow_tree_shared(Node<State>* root, const State& root_state,
+			  const ComputeOptions options,
+			  std::uint64_t initial_seed)
+    {
+      RandomGenerator random_engine = make_random_generator(options, 
+							    initial_seed);
+
+      attest(options.max_iterations >= 0 || options.max_time >= 0);
+
+      Deadline deadline(options.max_time);
+
+      vector<Node<State>*> path;
+
+      /* MCTS cycle - selection, expansion, simulation, backpropagation */
+      for (int iter = 1, playouts = 0; iter <= options.max_iterations || 
+	     options.max_iterations < 0; iter += playouts) {
+	playouts = playouts_in_batch(options, iter);
+	auto node = root;
+	State state = root_state;
+	path.clear();
+	node->add_virtual_loss();
+	path.push_back(node);
+
+	// SELECTION - Select a path through the tree to a leaf node.
+	while (node->is_expanded_shared() && node->has_children()) {
+	  node = node->select_child_UCT_shared();
+	  state.do_move(node->move);
+	  node->add_virtual_loss();
+	  path.push_back(node);
+	}
+
+	// EXPANSION - Expand the leaf unless another thread is at it, and 
+	// move to its first child.
+	if (node->try_expand_shared(state) && node->has_children()) {
+	  node = node->select_child_UCT_shared();
+	  state.do_move(node->move);
+	  node->add_virtual_loss();
+	  path.push_back(node);
+	}
+
+	// SIMULATION - We now play randomly until the game ends.
+	double result = random_playouts(state, playouts, options.leaf_threads,
+					&random_engine);
+
+	// BACKPROPAGATION - Turn the virtual losses into the result.
+	for (auto path_node: path) {
+	  path_node->update_shared(result_for(path_node->player_to_move, 
+					      result, playouts), playouts);
+	}
+
+	if (deadline.passed(playouts)) {
+	  break;
+	}
+      }
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to compute a single tree with all the threads together.
+     Each thread runs options.max_iterations iterations, so that the tree
+     gathers as many games as the trees of compute_move with root 
+     parallelization. Used by compute_move.
+     Unconstrained version. */
+  template<typename State>
+    std::unique_ptr<Node<State>> compute_tree_shared(const State root_state,
+						     const ComputeOptions 
+						     options)
+    {
+      using namespace std;
+
+      // Will support more players later.
+      attest(root_state.player_to_move == 1 || root_state.player_to_move == 2);
+      check(options.max_memory < 0, 
+	    "ComputeOptions::use_shared_tree does not support max_memory.");
+      check( ! options.use_transpositions,
+	    "ComputeOptions::use_shared_tree does not support "
+	    "use_transpositions.");
+
+      auto root = unique_ptr<Node<State>>(new Node<State>(root_state));
+
+      Deadline deadline(options.max_time);
+      vector<future<void>> futures;
+      const auto batch = thread_pool().new_batch();
+      Node<State>* shared_root = root.get();
+      for (int t = 0; t < options.number_of_threads; ++t) {
+	auto func = [t, shared_root, &root_state, &options, &deadline]()
 	  {
-	    return compute_tree(root_state, job_options, 1012411 * t + 12515);
+	    grow_tree_shared(shared_root, root_state, 
+			     deadline.job_options(options), 
+			     1012411 * t + 12515);
 	  };
 
-	root_futures.push_back(std::async(std::launch::async, func));
+	futures.push_back(thread_pool().submit(func, batch));
+      }
+      thread_pool().wait_all(futures, batch);
+      for (auto& future: futures) {
+	future.get();
+      }
+
+      return root;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to grow a tree with the MCTS algorithm, starting from an 
+     existing root for root_state. Used by compute_tree_capped and 
+     SearchSession.
+     Capped version - cap set by max_level, counted from the root. */
+  template<typename State>
+    void grow_tree_capped(Node<State>* root, const State& root_state,
+			  const ComputeOptions options,
+			  std::uint64_t initial_seed)
+    {
+      Search<State, UCTSelection, CappedExpansion, EarlyStopHooks<State>>
+	search(options, UCTSelection(), CappedExpansion(max_level));
+      search.grow(root, root_state, initial_seed);
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to compute the tree with the MCTS algorithm. 
+     Used by compute_move_capped.
+     Capped version - cap set by max_level. */
+  template<typename State>
+    std::unique_ptr<Node<State>> compute_tree_capped(const State root_state,
+						     const ComputeOptions 
+						     options,
+						     std::uint64_t
+						     initial_seed)
+    {
+      auto root = std::unique_ptr<Node<State>>(new Node<State>(root_state));
+      grow_tree_capped(root.get(), root_state, options, initial_seed);
+      return root;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to compute the tree with the MCTS algorithm. 
+     Used by compute_move_adapt.
+     ADAPTATIVE version - Uses sight inferred to infer moves of opponent */
+  template<typename State>
+    std::unique_ptr<Node<State>> compute_tree_adapt(const State root_state,
+	                                            const ComputeOptions options,
+	                                            std::uint64_t
+	                                            initial_seed,
+						    const int sight_inferred,
+						    const int max_sight)
+    {
+      Search<State, UCTSelection, FullExpansion, InferenceHooks>
+	search(options, UCTSelection(), FullExpansion(),
+	       InferenceHooks(sight_inferred, max_sight));
+      return search.compute_tree(root_state, initial_seed);
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+
+  /* Function to compute a tree to evaluate the opponent with uniform node 
+     selection as opposed to UCT */
+  /* Function to compute the tree with the MCTS algorithm. 
+     Used by compute_move_unif.
+     UNIFORM version - Uses Uniform tree policy when descending the tree */
+  template<typename State>
+    std::unique_ptr<Node<State>>  compute_tree_unif(const State root_state,
+						    const ComputeOptions options,
+						    std::uint64_t 
+						    initial_seed)
+    {
+      Search<State, UniformSelection, FullExpansion, NoHooks> search(options);
+      return search.compute_tree(root_state, initial_seed);
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function run by each of the threads growing a shared tree with the
+     uniform tree policy, see compute_tree_unif_shared. The threads take
+     their games from games_started, a counter shared by all of them, until
+     options.max_iterations games have been started. */
+  template<typename State>
+    void grow_tree_unif_shared(Node<State>* root, const State& root_state,
+			       const ComputeOptions options,
+			       std::uint64_t initial_seed,
+			       std::atomic<int>* games_started)
+    {
+      RandomGenerator random_engine = make_random_generator(options, 
+							    initial_seed);
+
+      Deadline deadline(options.max_time);
+
+      vector<Node<State>*> path;
+
+      while (true) {
+	int iter = games_started->fetch_add(options.playouts_per_leaf) + 1;
+	if (options.max_iterations >= 0 && iter > options.max_iterations) {
+	  break;
+	}
+	int playouts = playouts_in_batch(options, iter);
+	auto node = root;
+	State state = root_state;
+	path.clear();
+	node->add_virtual_loss();
+	path.push_back(node);
+
+	// Select a path through the tree until a node has an untried move,
+	// which is claimed and becomes the new leaf. The nodes met on the way
+	// are expanded by the first thread to reach them, the others spin 
+	// until the expansion is published.
+	while (true) {
+	  if ( ! node->try_expand_shared(state, true)) {
+	    while ( ! node->is_expanded_shared()) {
+	      std::this_thread::yield();
+	    }
+	  }
+	  auto leaf = node->claim_untried_child(&random_engine);
+	  if (leaf != nullptr) {
+	    state.do_move(leaf->move);
+	    leaf->add_virtual_loss();
+	    path.push_back(leaf);
+	    break;
+	  }
+	  if ( ! node->has_children()) {
+	    break;
+	  }
+	  node = node->select_child_unif(&random_engine);
+	  state.do_move(node->move);
+	  node->add_virtual_loss();
+	  path.push_back(node);
+	}
+
+	// We now play randomly until the game ends.
+	double result = random_playouts(state, playouts, options.leaf_threads,
+					&random_engine);
+
+	// Backpropagate the result, the visits being already counted.
+	for (auto path_node: path) {
+	  path_node->update_shared(result_for(path_node->player_to_move, 
+					      result, playouts), playouts);
+	}
+
+	if (deadline.passed(playouts)) {
+	  break;
+	}
       }
+    }
+  /* END OF FUNCTION DEFINITION */
 
-      // Collect the results.
-      vector<unique_ptr<Node<State>>> roots;
+
+
+  /* Recursive helper function to prune the children built by 
+     try_expand_shared whose move was never claimed. Their moves stay 
+     untried, so that the tree is the one compute_tree_unif would have grown
+     with the same games. */
+  template<typename State>
+    void prune_unclaimed_children(Node<State>* node)
+    {
+      for (auto child: node->children) {
+	std::uint64_t bit = std::uint64_t(1) << child->move;
+	if ((node->untried_moves.load(std::memory_order_relaxed) & bit) != 0) {
+	  node->prune_child(child);
+	}
+	else {
+	  prune_unclaimed_children(child);
+	}
+      }
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to compute the tree of compute_tree_unif with 
+     options.number_of_threads threads growing it together: each node is 
+     expanded once with all its children, by the first thread to reach it,
+     and the threads then claim its untried moves one by one with an atomic
+     update of the mask, so that every move still becomes a new leaf 
+     exactly once. The claims and statistics take no lock, but a thread
+     reaching a node still being expanded spins until the expansion is
+     published, so a preempted expander holds up the threads behind it. 
+     The threads share options.max_iterations games between them. Used by 
+     sight_array. */
+  template<typename State>
+    std::unique_ptr<Node<State>> compute_tree_unif_shared(const State 
+							  root_state,
+							  const ComputeOptions
+							  options)
+    {
+      using namespace std;
+
+      attest(options.max_iterations >= 0 || options.max_time >= 0);
+
+      // Will support more players later.
+      attest(root_state.player_to_move == 1 || root_state.player_to_move == 2);
+      check(options.max_memory < 0, 
+	    "compute_tree_unif_shared does not support max_memory.");
+      check( ! options.use_transpositions,
+	    "compute_tree_unif_shared does not support use_transpositions.");
+      auto root = unique_ptr<Node<State>>(new Node<State>(root_state));
+
+      Deadline deadline(options.max_time);
+      atomic<int> games_started(0);
+      vector<future<void>> futures;
+      const auto batch = thread_pool().new_batch();
+      Node<State>* shared_root = root.get();
       for (int t = 0; t < options.number_of_threads; ++t) {
-	roots.push_back(std::move(root_futures[t].get()));
+	auto func = [t, shared_root, &root_state, &options, &games_started,
+		     &deadline]()
+	  {
+	    grow_tree_unif_shared(shared_root, root_state, 
+				  deadline.job_options(options), 
+				  1012411 * t + 12515, &games_started);
+	  };
+
+	futures.push_back(thread_pool().submit(func, batch));
+      }
+      thread_pool().wait_all(futures, batch);
+      for (auto& future: futures) {
+	future.get();
       }
 
-      /* Part to print tree */
-      /*std::ofstream out;
-      string filename = "Sight_";
-      filename += (char)(max_level + '0');
-      filename += "/TreeFullCM.txt";
-      out.open(filename);
-      out << roots[0].get()->tree_to_string(3,0);
-      out.close();*/
-      /* Part to print tree */
+      prune_unclaimed_children(root.get());
+      return root;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+
+  /* Function to merge the children of the roots built by each thread and
+     find the best move among them. Also returns the total number of games
+     played in the trees, and if asked the visits and wins of the best move.
+     Used by compute_move and friends, and SearchSession. */
+  template<typename State>
+    typename State::Move merge_root_children(const vector<std::unique_ptr<
+					     Node<State>>>& roots,
+					     const ComputeOptions& options,
+					     long long& games_played,
+					     int* best_visits = nullptr,
+					     double* best_wins = nullptr)
+    {
+      using namespace std;
 
       // Merge the children of all root nodes.
       map<typename State::Move, int> visits;
       map<typename State::Move, double> wins;
-      long long games_played = 0;
-      for (int t = 0; t < options.number_of_threads; ++t) {
+      games_played = 0;
+      for (size_t t = 0; t < roots.size(); ++t) {
 	auto root = roots[t].get();
 	games_played += root->visits;
 	for (auto child = root->children.cbegin(); 
@@ -983,160 +3326,561 @@ namespace MCTS
       }
 
 
-      if (options.verbose) {
-	auto best_wins = wins[best_move];
-	auto best_visits = visits[best_move];
-	cerr << "----" << endl;
-	cerr << "Best: " << best_move
-	     << " (" << 100.0 * best_visits / double(games_played) <<"% visits)"
-	     << " (" << 100.0 * best_wins / best_visits << "% wins)" <<endl;
+      if (options.verbose) {
+	auto best_wins = wins[best_move];
+	auto best_visits = visits[best_move];
+	cerr << "----" << endl;
+	cerr << "Best: " << best_move
+	     << " (" << 100.0 * best_visits / double(games_played) <<"% visits)"
+	     << " (" << 100.0 * best_wins / best_visits << "% wins)" <<endl;
+      }
+
+      if (best_visits != nullptr) {
+	*best_visits = visits[best_move];
+      }
+      if (best_wins != nullptr) {
+	*best_wins = wins[best_move];
+      }
+
+      return best_move;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to compute options.number_of_threads trees in jobs of the 
+     thread pool, compute_tree(job_options, seed) computing each one with
+     the time left before deadline. Used by compute_move and friends. */
+  template<typename State, typename ComputeTree>
+    vector<std::unique_ptr<Node<State>>> compute_trees(const ComputeOptions&
+						       options, 
+						       const Deadline& deadline,
+						       ComputeTree compute_tree)
+    {
+      using namespace std;
+
+      // Start all jobs to compute trees.
+      vector<future<unique_ptr<Node<State>>>> root_futures;
+      const auto batch = thread_pool().new_batch();
+      ComputeOptions job_options = options;
+      job_options.verbose = false;
+      for (int t = 0; t < options.number_of_threads; ++t) {
+	auto func = [t, &job_options, &deadline, &compute_tree]()
+	  ->std::unique_ptr<Node<State>>
+	  {
+	    return compute_tree(deadline.job_options(job_options), 
+				std::uint64_t(1012411 * t + 12515));
+	  };
+
+	root_futures.push_back(thread_pool().submit(func, batch));
+      }
+
+      // Collect the results.
+      thread_pool().wait_all(root_futures, batch);
+      vector<unique_ptr<Node<State>>> roots;
+      for (int t = 0; t < options.number_of_threads; ++t) {
+	roots.push_back(root_futures[t].get());
+      }
+      return roots;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+
+  /* Function to compute move the move the algorithm will make
+     UNCONSTRAINED version. */
+  template<typename State>
+    typename State::Move compute_move(const State root_state,
+				      const ComputeOptions options)
+    {
+      using namespace std;
+
+      // Will support more players later.
+      attest(root_state.player_to_move == 1 || root_state.player_to_move == 2);
+
+      auto moves = root_state.get_moves();
+      attest(moves.size() > 0);
+      if (moves.size() == 1) {
+	return moves[0];
+      }
+
+      // The jobs end early enough to leave time for the merge.
+      Deadline deadline(options.max_time * (1 - MERGE_TIME_RESERVE));
+
+      // Compute the trees of all jobs, or the one shared tree.
+      vector<unique_ptr<Node<State>>> roots;
+      if (options.use_shared_tree) {
+	ComputeOptions job_options = options;
+	job_options.verbose = false;
+	roots.push_back(compute_tree_shared(root_state, 
+					    deadline.job_options(job_options)));
+      }
+      else {
+	// Root statistics shared by the trees, in slow root parallelization.
+	RootStatistics<State> shared_statistics;
+	RootStatistics<State>* root_statistics = nullptr;
+	if (options.root_sync_interval > 0 && options.number_of_threads > 1) {
+	  root_statistics = &shared_statistics;
+	}
+
+	roots = compute_trees<State>(options, deadline, 
+	  [&root_state, root_statistics](const ComputeOptions& job_options,
+					 std::uint64_t seed)
+	  {
+	    return compute_tree(root_state, job_options, seed, root_statistics);
+	  });
+      }
+
+      /* Part to print tree */
+      /*std::ofstream out;
+      string filename = "Sight_";
+      filename += (char)(max_level + '0');
+      filename += "/TreeFullCM.txt";
+      out.open(filename);
+      out << roots[0].get()->tree_to_string(3,0);
+      out.close();*/
+      /* Part to print tree */
+
+      // Merge the children of all root nodes and pick the best one.
+      long long games_played = 0;
+      auto best_move = merge_root_children(roots, options, games_played);
+
+
+      
+
+      if (options.verbose) {
+      double time = deadline.elapsed();
+      std::cerr << games_played << " games played in " 
+		<< time << " s. " 
+		<< "(" << double(games_played) / time 
+		<< " / second, "
+		<< options.number_of_threads << " parallel jobs)." << endl;
+    }
+
+      return best_move;
+    }
+  /* END OF FUNCTION DEFINIION */
+
+
+
+
+  /* Function to compute move the move the algorithm will make
+     CAPPED version. */
+  template<typename State>
+    typename State::Move compute_move_capped(const State root_state,
+					     const ComputeOptions options)
+    {
+      using namespace std;
+
+      // Will support more players later.
+      attest(root_state.player_to_move == 1 || root_state.player_to_move == 2);
+
+      auto moves = root_state.get_moves();
+      attest(moves.size() > 0);
+      if (moves.size() == 1) {
+	return moves[0];
+      }
+
+      // The jobs end early enough to leave time for the merge.
+      Deadline deadline(options.max_time * (1 - MERGE_TIME_RESERVE));
+
+      // Compute the trees of all jobs.
+      vector<unique_ptr<Node<State>>> roots = compute_trees<State>(options, 
+	deadline, [&root_state](const ComputeOptions& job_options,
+				std::uint64_t seed)
+	{
+	  return compute_tree_capped(root_state, job_options, seed);
+	});
+
+      // Merge the children of all root nodes and pick the best one. Its 
+      // statistics are also stored to analyse anomalies.
+      long long games_played = 0;
+      int best_visits = 0;
+      double best_wins = 0;
+      auto best_move = merge_root_children(roots, options, games_played,
+					   &best_visits, &best_wins);
+
+
+      /* Part to store time series of % win of best node to analyse anomalies */
+      string filename = "Sight_";
+      filename += (char)(max_level + '0');
+      filename += "/TS_%_win.txt";
+      {
+	ResultFile out_anom(filename);
+	out_anom << 100.0 * best_wins / best_visits;
+	out_anom << endl;
+      }
+
+      filename = "Sight_";
+      filename += (char)(max_level + '0');
+      filename += "/TS_%_visits.txt";
+      {
+	ResultFile out_anom(filename);
+	out_anom << 100.0 * best_visits / double(games_played);
+	out_anom << endl;
+      }
+      /* END OF Part to store time series of % win of best node to analise 
+	 anomalies */
+
+
+
+
+      if (options.verbose) {
+      double time = deadline.elapsed();
+      std::cerr << games_played << " games played in " 
+		<< time << " s. " 
+		<< "(" << double(games_played) / time 
+		<< " / second, "
+		<< options.number_of_threads << " parallel jobs)." << endl;
+      }
+
+      return best_move;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+
+  /* Stateful search which keeps its trees (one per thread, as in
+     compute_move) from one decision to the next. Every move played in the
+     game, ours and the opponent's, is reported with play(). The next call
+     to compute_move re-roots the trees at the matching descendant, keeping
+     its statistics and freeing the rest of the old trees, and only runs the
+     iterations still missing to reach options.max_iterations. Should the
+     moves reported not lead to the position given to compute_move (or to 
+     ponder), the trees are thrown away and the search starts afresh.
+     A capped session grows its trees like compute_tree_capped.
+     While the opponent thinks, ponder() keeps growing the trees for the 
+     position it has to play from, in background threads, until its reply
+     is reported with play(): the games played below the reply are then 
+     kept, and the next compute_move has that many fewer to play. */
+  template<typename State>
+    class SearchSession
+    {
+    public:
+      typedef typename State::Move Move;
+
+      SearchSession(const ComputeOptions options = ComputeOptions(),
+		    bool capped = false);
+      ~SearchSession();
+
+      Move compute_move(const State root_state);
+      void play(const Move& move);
+      void reset();
+      void ponder(const State& state);
+      void stop_pondering();
+
+      // Games carried over from previous decisions in the last compute_move.
+      long long reused_games() const
+      {
+	return games_reused;
+      }
+
+    private:
+      SearchSession(const SearchSession&);
+      SearchSession& operator = (const SearchSession&);
+
+      void reroot(const State& state);
+
+      const ComputeOptions options;
+      const bool capped;
+      vector<std::unique_ptr<Node<State>>> roots;
+      // Position the trees stand for, with the moves played since then;
+      // null when unknown, e.g. after an illegal move was reported.
+      std::unique_ptr<State> position;
+      vector<Move> moves_played;
+      long long games_reused;
+      vector<std::thread> ponderers;
+      vector<std::exception_ptr> ponder_errors;
+      std::atomic<bool> pondering;
+    };
+
+
+
+  /* Constructor */
+  template<typename State>
+    SearchSession<State>::SearchSession(const ComputeOptions options_, 
+					bool capped_) :
+    options(options_),
+    capped(capped_),
+    games_reused(0),
+    pondering(false)
+      { 
+	check( ! options.use_shared_tree, 
+	      "SearchSession does not support ComputeOptions::use_shared_tree.");
+      }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Destructor */
+  template<typename State>
+    SearchSession<State>::~SearchSession()
+    {
+      try {
+	stop_pondering();
+      }
+      catch (...) {
+      }
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to report a move played in the game, by either player. Stops
+     the pondering, the reply it was waiting for being there. */
+  template<typename State>
+    void SearchSession<State>::play(const Move& move)
+    {
+      stop_pondering();
+      moves_played.push_back(move);
+      if (position && 0 <= move && move < 64 &&
+	  (legal_moves_mask(*position) & (std::uint64_t(1) << move)) != 0) {
+	position->do_move(move);
+      }
+      else {
+	position.reset();
+      }
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to throw away the trees, e.g. when a new game starts */
+  template<typename State>
+    void SearchSession<State>::reset()
+    {
+      stop_pondering();
+      roots.clear();
+      position.reset();
+      moves_played.clear();
+      games_reused = 0;
+    }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to move the root of every tree down along the moves played
+     since the last decision, to state. Only the subtree below the new root
+     is kept, the trees where the line was never explored are dropped. All
+     the trees are dropped when the moves reported do not lead to state,
+     e.g. when one was missed, since they stand for another position. */
+  template<typename State>
+    void SearchSession<State>::reroot(const State& state)
+    {
+      for (auto& root: roots) {
+	if ( ! root) {
+	  continue;
+	}
+
+	Node<State>* node = root.get();
+	for (auto move: moves_played) {
+	  Node<State>* next = nullptr;
+	  for (auto child: node->children) {
+	    if (child->move == move) {
+	      next = child;
+	      break;
+	    }
+	  }
+	  node = next;
+	  if (node == nullptr) {
+	    break;
+	  }
+	}
+
+	if (node == nullptr) {
+	  root.reset();
+	}
+	else if (node != root.get()) {
+	  root = node->copy_subtree();
+	}
       }
+      moves_played.clear();
 
-
-      
-
-      #ifdef USE_OPENMP
-      if (options.verbose) {
-      double time = ::omp_get_wtime();
-      std::cerr << games_played << " games played in " 
-		<< double(time - start_time) << " s. " 
-		<< "(" << double(games_played) / (time - start_time) 
-		<< " / second, "
-		<< options.number_of_threads << " parallel jobs)." << endl;
+      if ( ! position || ! same_position(*position, state)) {
+	roots.clear();
+      }
+      position.reset(new State(state));
+      roots.resize(options.number_of_threads);
     }
-     #endif
+  /* END OF FUNCTION DEFINITION */
 
-      return best_move;
-    }
-  /* END OF FUNCTION DEFINIION */
 
 
+  /* Games each pondering thread plays between two checks for the reply */
+  const int PONDER_SLICE = 1000;
 
 
-  /* Function to compute move the move the algorithm will make
-     CAPPED version. */
+
+  /* Function to start growing the trees for state, the position after our
+     move, while the opponent decides. Each tree gets a thread of its own,
+     rather than a job of the thread pool, whose workers would otherwise be
+     held for as long as the opponent thinks, its own search included. The
+     threads play PONDER_SLICE games at a time until the reply comes (see 
+     play and stop_pondering), or until a tree holds options.max_iterations
+     games for each reply, since each reply would then already have a 
+     decision's worth of games on average. The memory budget holds as in 
+     compute_move. */
   template<typename State>
-    typename State::Move compute_move_capped(const State root_state,
-					     const ComputeOptions options)
+    void SearchSession<State>::ponder(const State& state)
     {
       using namespace std;
 
-      // Will support more players later.
-      attest(root_state.player_to_move == 1 || root_state.player_to_move == 2);
-
-      auto moves = root_state.get_moves();
-      attest(moves.size() > 0);
-      if (moves.size() == 1) {
-	return moves[0];
+      stop_pondering();
+      if ( ! state.has_moves()) {
+	return;
       }
 
-      #ifdef USE_OPENMP
-      double start_time = ::omp_get_wtime();
-      #endif
+      reroot(state);
 
-      // Start all jobs to compute trees.
-      vector<future<unique_ptr<Node<State>>>> root_futures;
-      ComputeOptions job_options = options;
-      job_options.verbose = false;
+      const long long max_games = options.max_iterations >= 0 ?
+	(long long)options.max_iterations * state.get_moves().size() :
+	numeric_limits<int>::max() / 2;
+
+      // The games the slices do not play are not saved: the search goes on
+      // with the next slice, and pondering returns no move.
+      ComputeOptions slice_options = options;
+      slice_options.verbose = false;
+      slice_options.max_iterations = PONDER_SLICE;
+      slice_options.max_time = -1;
+      slice_options.early_stop_saved = nullptr;
+
+      pondering = true;
+      ponder_errors.assign(options.number_of_threads, nullptr);
       for (int t = 0; t < options.number_of_threads; ++t) {
-	auto func = [t,&root_state,&job_options]()->std::unique_ptr<Node<State>>
+	if ( ! roots[t] || roots[t]->player_to_move != state.player_to_move) {
+	  roots[t].reset(new Node<State>(state));
+	}
+
+	Node<State>* root = roots[t].get();
+	bool capped_tree = capped;
+	std::atomic<bool>* active = &pondering;
+	std::exception_ptr* error = &ponder_errors[t];
+	auto func = [t, root, capped_tree, state, slice_options, max_games, 
+		     active, error]()
 	  {
-	    return compute_tree_capped(root_state, job_options, 
-				       1012411 * t + 12515);
+	    try {
+	      for (std::uint64_t slice = 0; 
+		   active->load() && root->visits < max_games; ++slice) {
+		std::uint64_t seed = 1012411 * std::uint64_t(t) + 12515 + 
+		  7919 * slice;
+		if (capped_tree) {
+		  grow_tree_capped(root, state, slice_options, seed);
+		}
+		else {
+		  grow_tree(root, state, slice_options, seed);
+		}
+	      }
+	    }
+	    catch (...) {
+	      *error = std::current_exception();
+	    }
 	  };
 
-	root_futures.push_back(std::async(std::launch::async, func));
+	ponderers.push_back(std::thread(func));
       }
+    }
+  /* END OF FUNCTION DEFINITION */
 
-      // Collect the results.
-      vector<unique_ptr<Node<State>>> roots;
-      for (int t = 0; t < options.number_of_threads; ++t) {
-	roots.push_back(std::move(root_futures[t].get()));
+
+
+  /* Function to stop the pondering threads, if any, within a slice. An
+     exception thrown in one of them is thrown again here. */
+  template<typename State>
+    void SearchSession<State>::stop_pondering()
+    {
+      pondering = false;
+      for (auto& ponderer: ponderers) {
+	ponderer.join();
       }
+      ponderers.clear();
 
-      // Merge the children of all root nodes.
-      map<typename State::Move, int> visits;
-      map<typename State::Move, double> wins;
-      long long games_played = 0;
-      for (int t = 0; t < options.number_of_threads; ++t) {
-	auto root = roots[t].get();
-	games_played += root->visits;
-	for (auto child = root->children.cbegin(); 
-	     child != root->children.cend(); ++child) {
-	  visits[(*child)->move] += (*child)->visits;
-	  wins[(*child)->move]   += (*child)->wins;
+      for (auto& error: ponder_errors) {
+	if (error) {
+	  auto rethrown = error;
+	  ponder_errors.clear();
+	  std::rethrow_exception(rethrown);
 	}
       }
+      ponder_errors.clear();
+    }
+  /* END OF FUNCTION DEFINITION */
 
-      // Find the node with the most visits.
-      double best_score = -1;
-      typename State::Move best_move = typename State::Move();
-      for (auto itr: visits) {
-	auto move = itr.first;
-	double v = itr.second;
-	double w = wins[move];
-	// Expected success rate assuming a uniform prior (Beta(1, 1)).
-	// https://en.wikipedia.org/wiki/Beta_distribution
-	double expected_success_rate = (w + 1) / (v + 2);
-	if (expected_success_rate > best_score) {
-	  best_move = move;
-	  best_score = expected_success_rate;
-	}
 
-	if (options.verbose) {
-	  cerr << "Move: " << itr.first
-	       << " (" << setw(2) << right 
-	       << int(100.0 * v / double(games_played) + 0.5) << "% visits)"
-	       << " (" << setw(2) << right << int(100.0 * w / v + 0.5)    
-	       << "% wins)" << endl;
-	}
-      }
 
-      // Moved the auto declared variables out of options.verbose to 
-      // store anomalies
-      auto best_wins = wins[best_move];
-      auto best_visits = visits[best_move];
-      if (options.verbose) {
-	cerr << "----" << endl;
-	cerr << "Best: " << best_move
-	     << " (" << 100.0 * best_visits / double(games_played) <<"% visits)"
-	     << " (" << 100.0 * best_wins / best_visits << "% wins)" << endl;
+  /* Function to compute the move to make, growing the trees kept from the
+     previous decisions. */
+  template<typename State>
+    typename State::Move SearchSession<State>::compute_move(const State 
+							    root_state)
+    {
+      using namespace std;
+
+      // Will support more players later.
+      attest(root_state.player_to_move == 1 || root_state.player_to_move == 2);
+
+      auto moves = root_state.get_moves();
+      attest(moves.size() > 0);
+      if (moves.size() == 1) {
+	return moves[0];
       }
 
+      // The jobs end early enough to leave time for the merge.
+      Deadline deadline(options.max_time * (1 - MERGE_TIME_RESERVE));
 
-      /* Part to store time series of % win of best node to analyse anomalies */
-      ofstream out_anom;
-      string filename = "Sight_";
-      filename += (char)(max_level + '0');
-      filename += "/TS_%_win.txt";
-      out_anom.open(filename, std::fstream::app);
-      out_anom << 100.0 * best_wins / best_visits;
-      out_anom << endl;
-      out_anom.close();      
+      stop_pondering();
+      reroot(root_state);
 
-      filename = "Sight_";
-      filename += (char)(max_level + '0');
-      filename += "/TS_%_visits.txt";
-      out_anom.open(filename, std::fstream::app);
-      out_anom << 100.0 * best_visits / double(games_played);
-      out_anom << endl;
-      out_anom.close();      
-      /* END OF Part to store time series of % win of best node to analise 
-	 anomalies */
+      // Start all jobs to grow the trees, each one for the iterations it
+      // is missing.
+      games_reused = 0;
+      vector<future<void>> futures;
+      const auto batch = thread_pool().new_batch();
+      for (int t = 0; t < options.number_of_threads; ++t) {
+	if ( ! roots[t] || 
+	     roots[t]->player_to_move != root_state.player_to_move) {
+	  roots[t].reset(new Node<State>(root_state));
+	}
+	games_reused += roots[t]->visits;
+
+	ComputeOptions job_options = options;
+	job_options.verbose = false;
+	if (options.max_iterations >= 0) {
+	  job_options.max_iterations = max(0, options.max_iterations - 
+					   roots[t]->visits);
+	}
 
+	Node<State>* root = roots[t].get();
+	bool capped_tree = capped;
+	auto func = [t, root, capped_tree, &root_state, &deadline, 
+		     job_options]()
+	  {
+	    if (capped_tree) {
+	      grow_tree_capped(root, root_state, 
+			       deadline.job_options(job_options), 
+			       1012411 * t + 12515);
+	    }
+	    else {
+	      grow_tree(root, root_state, deadline.job_options(job_options), 
+			1012411 * t + 12515);
+	    }
+	  };
 
+	futures.push_back(thread_pool().submit(func, batch));
+      }
+      thread_pool().wait_all(futures, batch);
+      for (auto& future: futures) {
+	future.get();
+      }
 
+      long long games_played = 0;
+      auto best_move = merge_root_children(roots, options, games_played);
 
-      #ifdef USE_OPENMP
       if (options.verbose) {
-      double time = ::omp_get_wtime();
-      std::cerr << games_played << " games played in " 
-		<< double(time - start_time) << " s. " 
-		<< "(" << double(games_played) / (time - start_time) 
-		<< " / second, "
-		<< options.number_of_threads << " parallel jobs)." << endl;
+	cerr << games_reused << " of " << games_played 
+	     << " games reused from previous decisions." << endl;
       }
-      #endif
 
       return best_move;
     }
@@ -1181,31 +3925,17 @@ namespace MCTS
       }
 
 
-      #ifdef USE_OPENMP
-        double start_time = ::omp_get_wtime();
-      #endif
-
-      // Start all jobs to compute trees.
-      vector<future<unique_ptr<Node<State>>>> root_futures;
-      ComputeOptions job_options = options;
-      job_options.verbose = false;
-      for (int t = 0; t < options.number_of_threads; ++t) {
-	auto func = [t, &root_state, &job_options, &sight_inferred, &max_sight] () 
-	  -> std::unique_ptr<Node<State>>
-	  {
-	    return compute_tree_adapt(root_state, job_options, 
-				      1012411 * t + 12515, sight_inferred, 
-				      max_sight);
-	  };
-
-	root_futures.push_back(std::async(std::launch::async, func));
-      }
+      // The jobs end early enough to leave time for the merge.
+      Deadline deadline(options.max_time * (1 - MERGE_TIME_RESERVE));
 
-      // Collect the results.
-      vector<unique_ptr<Node<State>>> roots;
-      for (int t = 0; t < options.number_of_threads; ++t) {
-	roots.push_back(std::move(root_futures[t].get()));
-      }
+      // Compute the trees of all jobs.
+      vector<unique_ptr<Node<State>>> roots = compute_trees<State>(options, 
+	deadline, [&root_state, sight_inferred, &max_sight]
+	(const ComputeOptions& job_options, std::uint64_t seed)
+	{
+	  return compute_tree_adapt(root_state, job_options, seed, 
+				    sight_inferred, max_sight);
+	});
 
       /* Part to print tree */
       /*std::ofstream out;
@@ -1217,71 +3947,22 @@ namespace MCTS
       out.close(); */
       /* Part to print tree */
 
-      // Merge the children of all root nodes.
-      map<typename State::Move, int> visits;
-      map<typename State::Move, double> wins;
+      // Merge the children of all root nodes and pick the best one.
       long long games_played = 0;
-      for (int t = 0; t < options.number_of_threads; ++t) {
-	auto root = roots[t].get();
-	games_played += root->visits;
-	for (auto child = root->children.cbegin(); 
-	     child != root->children.cend(); ++child) {
-	  visits[(*child)->move] += (*child)->visits;
-	  wins[(*child)->move]   += (*child)->wins;
-	}
-      }
-
-      // Find the node with the most visits.
-      double best_score = -1;
-      typename State::Move best_move = typename State::Move();
-      for (auto itr: visits) {
-	auto move = itr.first;
-	double v = itr.second;
-	double w = wins[move];
-	// Expected success rate assuming a uniform prior (Beta(1, 1)).
-	// https://en.wikipedia.org/wiki/Beta_distribution
-	double expected_success_rate = (w + 1) / (v + 2);
-	if (expected_success_rate > best_score) {
-	  best_move = move;
-	  best_score = expected_success_rate;
-	}
-	
-	
-	if (options.verbose) {
-	  cerr << "Move: " << itr.first
-	  << " (" << setw(2) << right 
-	       << int(100.0 * v / double(games_played) + 0.5) << "% visits)"
-	  << " (" << setw(2) << right << int(100.0 * w / v + 0.5)    
-	       << "% wins)" << endl;
-	}
-      }
-
-
-      if (options.verbose) {
-	auto best_wins = wins[best_move];
-	auto best_visits = visits[best_move];
-	cerr << "----" << endl;
-	cerr << "Best: " << best_move
-	     << " (" << 100.0 * best_visits / double(games_played) 
-	     << "% visits)"
-	     << " (" << 100.0 * best_wins / best_visits << "% wins)" 
-	     << endl;
-      }
+      auto best_move = merge_root_children(roots, options, games_played);
 
 
       
 
-      #ifdef USE_OPENMP
       if (options.verbose) {
-      double time = ::omp_get_wtime();
+      double time = deadline.elapsed();
       std::cerr << games_played << " games played in " 
-		<< double(time - start_time) << " s. " 
-		<< "(" << double(games_played) / (time - start_time) 
+		<< time << " s. " 
+		<< "(" << double(games_played) / time 
 		<< " / second, "
 		<< options.number_of_threads << " parallel jobs)." 
 		<< endl;
       }
-      #endif
 
 
 
@@ -1299,13 +3980,11 @@ namespace MCTS
       }      
       
       /* save the predicted counter-move */
-      std::ofstream out;
       string filename = "Sight_";
       filename += (char)(max_level + '0');
       filename += "/moves_inferred.txt";
-      out.open(filename, std::fstream::app);
+      ResultFile out(filename);
       out << counter_move;
-      out.close();
       
 
       return best_move;
@@ -1336,23 +4015,70 @@ namespace MCTS
 
   
 
-  /* Function to calculate the sight array */  
+  /* Function to calculate the sight array, or to read it from 
+     options.sight_cache if it was computed already. Computed by 
+     sight_array_uncached. */
   template<typename State>
     vector<typename State::Move> sight_array(const State root_state, const int&
 					     max_sight, const ComputeOptions 
 					     options){
 
+    if (options.sight_cache == nullptr) {
+      return sight_array_uncached(root_state, max_sight, options);
+    }
+
+    check(has_hash<State>::value,
+	  "ComputeOptions::sight_cache requires State::get_hash().");
+    auto compute = [&root_state, &max_sight, &options]()
+      {
+	auto moves = sight_array_uncached(root_state, max_sight, options);
+	return vector<int>(moves.begin(), moves.end());
+      };
+    auto cached = 
+      options.sight_cache->find_or_compute(position_hash(root_state), 
+					   max_sight, options.max_iterations,
+					   compute);
+    return vector<typename State::Move>(cached.begin(), cached.end());
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Share of ComputeOptions::max_time held back by sight_array_uncached for
+     the backward induction over the tree and its release, which are not 
+     interrupted: both take about a tenth of the time of the search. */
+  const double SIGHT_TIME_RESERVE = 0.2;
+
+  /* Function to calculate the sight array */  
+  template<typename State>
+    vector<typename State::Move> sight_array_uncached(const State root_state,
+						      const int& max_sight, 
+						      const ComputeOptions 
+						      options){
+
     // Initialize sight array
     vector<typename State::Move> sight_array;
     sight_array.resize(max_sight, -1);
 
-    // Compute the tree
+    // Compute the tree. The opponent's tree is a plain one, without 
+    // transpositions or collapsed subtrees, which backward induction would
+    // take for leaves: its shape must not depend on these options, nor on
+    // the builder picked by the number of threads.
     ComputeOptions job_options = options;
     job_options.verbose = false;
+    job_options.use_transpositions = false;
+    job_options.max_memory = -1;
+    // Backward induction and freeing the tree take a share of max_time.
+    job_options.max_time = options.max_time * (1 - SIGHT_TIME_RESERVE);
 
     // Uses UNIFORM tree policy
-    auto root = compute_tree_unif(root_state, job_options, 1943); 
-    //does not matter the seed is fixed as it is altered with RD
+    std::unique_ptr<Node<State>> root;
+    if (options.number_of_threads > 1) {
+      root = compute_tree_unif_shared(root_state, job_options);
+    }
+    else {
+      root = compute_tree_unif(root_state, job_options, 1943); 
+    }
 
 
     /* Part to print tree */
@@ -1366,13 +4092,10 @@ namespace MCTS
     /* Part to print tree */
     
           
-    // Compute the sight array
-    Node<State>* root_naked = root.get();
-    for (int sight_level = 1; sight_level <= max_sight; sight_level++){
-      // Uses TIEBREAK rule
-      sight_array[sight_level - 1] = backward_induction_tiebreak(root_naked, 
-								 sight_level);   
-    }
+    // Compute the sight array, all the levels in one pass with the same
+    // choices as backward_induction_tiebreak
+    sight_array = backward_induction_all_depths(root.get(), max_sight,
+						options.number_of_threads);
   
     return sight_array;
   }
@@ -1511,6 +4234,123 @@ namespace MCTS
 
 
 
+  /* Depth from which backward_induction_all_depths computes the children
+     of the root in parallel: shallower passes take less time than handing
+     out the jobs. */
+  const int BI_PARALLEL_DEPTH = 5;
+
+
+
+  /* Recursive helper function to calculate the backward induction values
+     of a node for all the depths from 0 to depth at once, into 
+     values[0..depth]: values[r] is what backward_induction_helper(node, r)
+     returns. The values of the children are computed in the space after
+     values, of (depth + 1) * (depth + 2) / 2 doubles in all. */
+  template<typename State>
+    void backward_induction_values(Node<State>* node, int depth, 
+				   double* values){
+
+    const double value = node->wins / node->visits;
+    if ((depth == 0) || !(node->has_children())) {
+      std::fill(values, values + depth + 1, value);
+      return;
+    }
+
+    // values[r - 1] keeps the best value of the children at depth r - 1.
+    double* child_values = values + depth + 1;
+    bool first = true;
+    for (auto child = node->children.begin(); child != node->children.end(); 
+	 ++child) {
+      backward_induction_values((*child), depth - 1, child_values);
+      for (int r = 0; r < depth; r++) {
+	values[r] = first ? child_values[r] : max(values[r], child_values[r]);
+      }
+      first = false;
+    }
+
+    for (int r = depth; r >= 1; r--) {
+      values[r] = 1 - values[r - 1];
+    }
+    values[0] = value;
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+  /* Function to calculate the moves backward_induction_tiebreak chooses at
+     every depth from 1 to max_depth, in one pass over the tree rather than
+     one per depth. The values are kept in arrays on the side, the nodes are
+     not written to. As called in turn for depths 1, 2, ... (by sight_array)
+     the tiebreak rule always sees a BI_depth of 1 on the children of the 
+     root, so that the move chosen is the first child whose rounded value 
+     is the best one. With threads > 1, the children of the root are 
+     computed in parallel on the thread pool, for max_depth of at least 
+     BI_PARALLEL_DEPTH. */
+  template<typename State>
+    vector<typename State::Move> backward_induction_all_depths(Node<State>* 
+							       root, 
+							       int max_depth,
+							       int threads){
+
+    vector<typename State::Move> moves(max_depth, -1);
+    if (root->children.size() == 0) {
+      return moves;
+    }
+
+    // Values of the children for depths 0 to max_depth - 1, one row each.
+    vector<Node<State>*> children;
+    for (auto child: root->children) {
+      children.push_back(child);
+    }
+    const int row = max_depth * (max_depth + 1) / 2;
+    vector<double> values(children.size() * row);
+    auto compute = [&children, &values, row, max_depth](std::size_t c)
+      {
+	backward_induction_values(children[c], max_depth - 1, 
+				  &values[c * row]);
+      };
+
+    if (threads > 1 && max_depth >= BI_PARALLEL_DEPTH) {
+      vector<std::future<void>> futures;
+      const auto batch = thread_pool().new_batch();
+      for (std::size_t c = 0; c < children.size(); c++) {
+	futures.push_back(thread_pool().submit([c, &compute]() 
+					       { compute(c); }, batch));
+      }
+      thread_pool().wait_all(futures, batch);
+      for (auto& future: futures) {
+	future.get();
+      }
+    }
+    else {
+      for (std::size_t c = 0; c < children.size(); c++) {
+	compute(c);
+      }
+    }
+
+    for (int depth = 1; depth <= max_depth; depth++) {
+      double best_value = -1;
+      for (std::size_t c = 0; c < children.size(); c++) {
+	best_value = max(best_value, values[c * row + depth - 1]);
+      }
+      const double BI_value = 1 - best_value;
+
+      for (std::size_t c = 0; c < children.size(); c++) {
+	if (round(100000*values[c * row + depth - 1]) == 
+	    round(100000*(1.0 - BI_value))) {
+	  moves[depth - 1] = children[c]->move;
+	  break;
+	}
+      }
+    }
+
+    return moves;
+  }
+  /* END OF FUNCTION DEFINITION */
+
+
+
+
   /* Recursive helper function to calculate the backward induction,
      TIEBREAK version */
   template<typename State>
@@ -1522,7 +4362,7 @@ namespace MCTS
     if (root->has_children()){
       for (auto child_check = root->children.begin(); 
 	   child_check != root->children.end(); ++child_check) {
-	if ((*child_check)->moves.size() > 0){
+	if ((*child_check)->has_untried_moves()){
 	  flag_interrupt = true;
 	  break;
 	}
@@ -1564,16 +4404,16 @@ namespace MCTS
     //cout << "lamda_evidence is: [" << lambda_evidence << "]" <<  endl;
 
     /* save lambda evidence */
-    ofstream out1;
     string filename = "Sight_";
     filename += (char)(max_level + '0');
     filename += "/lambda_evidence.txt";
-    out1.open(filename, std::fstream::app);
-    for (unsigned int i = 0; i < max_sight; i++){
-      out1 << lambda_evidence[i] << " " ;
+    {
+      ResultFile out1(filename);
+      for (unsigned int i = 0; i < max_sight; i++){
+	out1 << lambda_evidence[i] << " " ;
+      }
+      out1 << endl;
     }
-    out1 << endl;
-    out1.close();
     /* save moves_chosen */
 
     //cout << "prior is: [" << prior << "]" <<  endl;
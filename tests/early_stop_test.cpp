@@ -0,0 +1,104 @@
+// Cataldo Azzariti 2016
+// cataldo.azzariti@gmail.com
+
+// Tests of the early termination, ComputeOptions::early_stop_interval: the
+// games it saves are counted for the call they were saved in.
+
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <Eigen/Dense>
+using namespace std;
+using namespace Eigen;
+
+// Globals expected by mcts.h.
+int max_level = 2;
+thread_local bool save_move = false;
+
+#include <mcts.h>
+
+
+#include "connect_four.h"
+
+
+
+/* Function to get a position where one move wins at once, so that the
+   search is decided early */
+ConnectFourState winning_position()
+{
+  ConnectFourState state;
+  const ConnectFourState::Move moves[] = {0, 6, 1, 6, 2, 5};
+  for (auto move: moves) {
+    state.do_move(move);
+  }
+  return state;
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* Each call counts the games saved in its own trees only */
+void test_saved_per_call()
+{
+  MCTS::ComputeOptions options;
+  options.max_iterations = 50000;
+  options.early_stop_interval = 1000;
+  options.number_of_threads = 2;
+  options.random_seed = 2016;
+
+  std::atomic<long long> saved_decided(0);
+  options.early_stop_saved = &saved_decided;
+  auto move = MCTS::compute_move(winning_position(), options);
+  attest(move == 3);
+  attest(0 < saved_decided && saved_decided < 2 * 50000);
+
+  // Nothing is written to the result files.
+  MCTS::ResultBuffer files;
+  MCTS::ResultBuffer::of_this_thread() = &files;
+  const long long saved_first = saved_decided;
+  std::atomic<long long> saved_capped(0);
+  options.early_stop_saved = &saved_capped;
+  MCTS::compute_move_capped(winning_position(), options);
+  MCTS::ResultBuffer::of_this_thread() = nullptr;
+  attest(saved_capped > 0);
+  attest(saved_decided == saved_first);
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* Pondering returns no move, the games its slices do not play are not
+   counted */
+void test_ponder_not_counted()
+{
+  MCTS::ComputeOptions options;
+  options.max_iterations = 50000;
+  options.early_stop_interval = 100;
+  std::atomic<long long> saved(0);
+  options.early_stop_saved = &saved;
+
+  MCTS::SearchSession<ConnectFourState> session(options);
+  session.ponder(winning_position());
+  this_thread::sleep_for(chrono::milliseconds(200));
+  session.stop_pondering();
+  attest(saved == 0);
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* Main program. */
+int main()
+{
+  try {
+    test_saved_per_call();
+    test_ponder_not_counted();
+  }
+  catch (std::exception& error) {
+    std::cerr << "ERROR: " << error.what() << std::endl;
+    return 1;
+  }
+  std::cout << "OK" << std::endl;
+}
+/* END OF MAIN PROGRAM */
@@ -0,0 +1,121 @@
+// Cataldo Azzariti 2016
+// cataldo.azzariti@gmail.com
+
+// Tests of the memory budget, ComputeOptions::max_memory: the chunks given
+// back to the arena must be reused whatever their size, so that a search 
+// under a budget keeps its tree near the budget rather than far below it.
+
+
+#include <iostream>
+#include <stdexcept>
+#include <Eigen/Dense>
+using namespace std;
+using namespace Eigen;
+
+// Globals expected by mcts.h.
+int max_level = 2;
+thread_local bool save_move = false;
+
+#include <mcts.h>
+
+
+#include "connect_four.h"
+
+
+typedef MCTS::Node<ConnectFourState> Node;
+
+
+
+/* Function to count the nodes of a tree */
+long long count_nodes(const Node* node)
+{
+  long long nodes = 1;
+  for (auto child: node->children) {
+    nodes += count_nodes(child);
+  }
+  return nodes;
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* Free chunks next to each other are merged, and a larger free chunk is 
+   split to serve a smaller request. */
+void test_arena_reuse()
+{
+  MCTS::NodeArena arena;
+  char* first = static_cast<char*>(arena.allocate(7 * 104, 8));
+  char* second = static_cast<char*>(arena.allocate(7 * 104, 8));
+  attest(second == first + 7 * 104);
+  arena.release(second, 7 * 104);
+  arena.release(first, 7 * 104);
+  attest(arena.growth_for(14 * 104, 8) == 0);
+  attest(arena.allocate(3 * 104, 8) == first);
+  attest(arena.allocate(11 * 104, 8) == first + 3 * 104);
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* A search with more games than the budget holds nodes keeps its tree 
+   within the budget, and near it. */
+void test_tree_near_budget(long long budget)
+{
+  MCTS::ComputeOptions options;
+  options.max_iterations = 300000;
+  options.max_memory = budget;
+  ConnectFourState state;
+  auto root = MCTS::compute_tree(state, options, 2016);
+
+  attest(root->arena->bytes_reserved() <= std::size_t(budget));
+  const long long cap = budget / sizeof(Node);
+  const long long nodes = count_nodes(root.get());
+  std::cout << budget << " bytes: " << nodes << " nodes of at most " << cap 
+	    << std::endl;
+  attest(4 * nodes >= 3 * cap);
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* A budget smaller than the first block of the arena is rejected, while 
+   one block is enough to choose a move. */
+void test_smallest_budget()
+{
+  MCTS::ComputeOptions options;
+  options.max_iterations = 20000;
+  options.max_memory = MCTS::ARENA_BLOCK_SIZE - 1;
+  ConnectFourState state;
+  bool rejected = false;
+  try {
+    MCTS::compute_move(state, options);
+  }
+  catch (std::invalid_argument&) {
+    rejected = true;
+  }
+  attest(rejected);
+
+  options.max_memory = MCTS::ARENA_BLOCK_SIZE;
+  auto move = MCTS::compute_move(state, options);
+  attest(0 <= move && move < 7);
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* Main program. */
+int main()
+{
+  try {
+    test_arena_reuse();
+    test_tree_near_budget(2 << 20);
+    test_tree_near_budget(4 << 20);
+    test_smallest_budget();
+  }
+  catch (std::exception& error) {
+    std::cerr << "ERROR: " << error.what() << std::endl;
+    return 1;
+  }
+  std::cout << "OK" << std::endl;
+}
+/* END OF MAIN PROGRAM */
@@ -0,0 +1,122 @@
+// Cataldo Azzariti 2016
+// cataldo.azzariti@gmail.com
+
+// Tests of SearchSession: the trees it keeps from one decision to the next
+// must stand for the position it is asked to play from, whatever moves
+// were reported to it.
+
+
+#include <iostream>
+#include <Eigen/Dense>
+using namespace std;
+using namespace Eigen;
+
+// Globals expected by mcts.h.
+int max_level = 2;
+thread_local bool save_move = false;
+
+#include <mcts.h>
+
+
+#include "connect_four.h"
+
+
+
+/* Function to fill the middle column of the 6x7 board, the move a search
+   of the empty board prefers, so that the tree of the empty board would 
+   choose a move no longer legal. */
+ConnectFourState full_middle_column()
+{
+  ConnectFourState state;
+  for (int row = 0; row < 6; ++row) {
+    state.do_move(3);
+  }
+  return state;
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* Function to check that a move is legal in state */
+void attest_legal(const ConnectFourState& state, ConnectFourState::Move move)
+{
+  auto moves = state.get_moves();
+  attest(find(moves.begin(), moves.end(), move) != moves.end());
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* The moves leading to the position were never reported with play() */
+void test_missed_moves(const MCTS::ComputeOptions& options)
+{
+  MCTS::SearchSession<ConnectFourState> session(options);
+  ConnectFourState empty_board;
+  attest_legal(empty_board, session.compute_move(empty_board));
+
+  auto state = full_middle_column();
+  attest(state.player_to_move == empty_board.player_to_move);
+  attest_legal(state, session.compute_move(state));
+  attest(session.reused_games() == 0);
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* Other moves than those leading to the position were reported */
+void test_wrong_moves(const MCTS::ComputeOptions& options)
+{
+  MCTS::SearchSession<ConnectFourState> session(options);
+  ConnectFourState empty_board;
+  attest_legal(empty_board, session.compute_move(empty_board));
+  for (int row = 0; row < 6; ++row) {
+    session.play(0);
+  }
+
+  auto state = full_middle_column();
+  attest_legal(state, session.compute_move(state));
+  attest(session.reused_games() == 0);
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* The moves reported lead to the position: the trees are kept */
+void test_reported_moves(const MCTS::ComputeOptions& options)
+{
+  MCTS::SearchSession<ConnectFourState> session(options);
+  ConnectFourState state;
+  for (int turn = 0; turn < 4; ++turn) {
+    auto move = session.compute_move(state);
+    attest_legal(state, move);
+    state.do_move(move);
+    session.play(move);
+  }
+  session.compute_move(state);
+  attest(session.reused_games() > 0);
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* Main program. */
+int main()
+{
+  try {
+    MCTS::ComputeOptions options;
+    options.max_iterations = 20000;
+    options.random_seed = 2016;
+    test_missed_moves(options);
+    test_wrong_moves(options);
+    test_reported_moves(options);
+    options.number_of_threads = 2;
+    test_missed_moves(options);
+    test_reported_moves(options);
+  }
+  catch (std::exception& error) {
+    std::cerr << "ERROR: " << error.what() << std::endl;
+    return 1;
+  }
+  std::cout << "OK" << std::endl;
+}
+/* END OF MAIN PROGRAM */
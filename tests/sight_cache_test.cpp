@@ -0,0 +1,189 @@
+// Cataldo Azzariti 2016
+// cataldo.azzariti@gmail.com
+
+// Tests of SightArrayCache with the thread pool: a position asked for by
+// several threads at once is computed once, and the threads waiting for 
+// it never hold up the jobs its computation waits for. A deadlock makes 
+// the test fail after a while rather than hang.
+
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <Eigen/Dense>
+using namespace std;
+using namespace Eigen;
+
+// Globals expected by mcts.h.
+int max_level = 2;
+thread_local bool save_move = false;
+
+#include <mcts.h>
+
+
+#include "connect_four.h"
+
+
+const int MAX_SIGHT = 5;
+
+
+
+/* Function to end the program if it has not finished in time */
+void start_watchdog(const std::atomic<bool>* done, int seconds)
+{
+  std::thread([done, seconds]()
+    {
+      auto end = chrono::steady_clock::now() + chrono::seconds(seconds);
+      while ( ! done->load() && chrono::steady_clock::now() < end) {
+	this_thread::sleep_for(chrono::milliseconds(100));
+      }
+      if ( ! done->load()) {
+	std::cerr << "ERROR: deadlock, not finished after " << seconds 
+		  << " s." << std::endl;
+	std::_Exit(1);
+      }
+    }).detach();
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* Jobs of the pool ask for the same position while it is computed by 
+   jobs which wait for jobs of their own, as the trees of a sight array
+   wait for their leaf playouts. */
+void test_nested_jobs()
+{
+  auto& pool = MCTS::thread_pool();
+  MCTS::SightArrayCache cache;
+  std::atomic<int> computed(0);
+  auto compute = [&pool, &computed]()
+    {
+      ++computed;
+      const auto trees = pool.new_batch();
+      vector<future<int>> tree_futures;
+      for (int t = 0; t < 4; ++t) {
+	tree_futures.push_back(pool.submit([&pool]()
+	  {
+	    const auto leaves = pool.new_batch();
+	    vector<future<int>> leaf_futures;
+	    for (int l = 0; l < 4; ++l) {
+	      leaf_futures.push_back(pool.submit([]()
+		{
+		  this_thread::sleep_for(chrono::milliseconds(1));
+		  return 1;
+		}, leaves));
+	    }
+	    pool.wait_all(leaf_futures, leaves);
+	    int sum = 0;
+	    for (auto& future: leaf_futures) {
+	      sum += future.get();
+	    }
+	    return sum;
+	  }, trees));
+      }
+      pool.wait_all(tree_futures, trees);
+      vector<int> sight_array;
+      for (auto& future: tree_futures) {
+	sight_array.push_back(future.get());
+      }
+      return sight_array;
+    };
+
+  const auto askers = pool.new_batch();
+  vector<future<vector<int>>> futures;
+  for (int a = 0; a < 16; ++a) {
+    futures.push_back(pool.submit([&cache, &compute]()
+      {
+	return cache.find_or_compute(2016, MAX_SIGHT, 1000, compute);
+      }, askers));
+  }
+  pool.wait_all(futures, askers);
+  for (auto& future: futures) {
+    attest(future.get() == vector<int>(4, 4));
+  }
+  attest(computed == 1);
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* Games played in parallel as by the driver (connect_four.cpp), each 
+   with its sight cache, by the adaptative search with leaf threads. */
+void test_parallel_games()
+{
+  MCTS::ComputeOptions options;
+  options.max_iterations = 5000;
+  options.number_of_threads = 2;
+  options.playouts_per_leaf = 4;
+  options.leaf_threads = 2;
+  options.random_seed = 2016;
+
+  const int games = 4;
+  vector<std::thread> threads;
+  vector<std::exception_ptr> errors(games);
+  for (int g = 0; g < games; ++g) {
+    threads.push_back(std::thread([g, &options, &errors]()
+      {
+	try {
+	  // Nothing is written to the result files.
+	  MCTS::ResultBuffer files;
+	  MCTS::ResultBuffer::of_this_thread() = &files;
+	  MCTS::SightArrayCache sight_cache;
+	  auto game_options = options;
+	  game_options.sight_cache = &sight_cache;
+	  const vector<double> belief = {0, 0, 1, 0, 0};
+
+	  ConnectFourState state;
+	  for (int turn = 0; turn < 8 && state.has_moves(); ++turn) {
+	    ConnectFourState::Move move;
+	    if (state.player_to_move == 1) {
+	      MCTS::sight_array(state, MAX_SIGHT, game_options);
+	      move = MCTS::compute_move_capped(state, game_options);
+	    }
+	    else {
+	      move = MCTS::compute_adaptative_move_UCT(state, MAX_SIGHT, 
+						       belief, game_options);
+	    }
+	    state.do_move(move);
+	  }
+	  MCTS::ResultBuffer::of_this_thread() = nullptr;
+	}
+	catch (...) {
+	  errors[g] = std::current_exception();
+	}
+      }));
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+  for (auto& error: errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+/* END OF FUNCTION DEFINITION */
+
+
+
+/* Main program. */
+int main()
+{
+  std::atomic<bool> done(false);
+  start_watchdog(&done, 120);
+  try {
+    MCTS::configure_thread_pool(4);
+    for (int repetition = 0; repetition < 20; ++repetition) {
+      test_nested_jobs();
+    }
+    test_parallel_games();
+  }
+  catch (std::exception& error) {
+    std::cerr << "ERROR: " << error.what() << std::endl;
+    return 1;
+  }
+  done = true;
+  std::cout << "OK" << std::endl;
+}
+/* END OF MAIN PROGRAM */